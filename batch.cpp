@@ -0,0 +1,261 @@
+// batch.cpp
+#include "batch.h"
+#include "diagnostics.h"
+#include "schemefile.h"
+#include <charconv>
+
+const std::size_t BatchRunner::READ_BUFFER_SIZE;
+const std::size_t BatchRunner::MAX_PENDING;
+
+static bool parseInt(std::string_view token, int& value) {
+    const char* end = token.data() + token.size();
+    auto result = std::from_chars(token.data(), end, value);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+static const char* describeStatus(PlacementStatus status) {
+    switch (status) {
+        case PlacementStatus::INVALID_LAYER: return "layer doesn't exist";
+        case PlacementStatus::INVALID_ELEMENT: return "invalid element";
+        case PlacementStatus::OVERLAP_EXISTING: return "overlaps an existing element";
+        case PlacementStatus::OVERLAP_BATCH: return "overlaps an element of the same batch";
+        case PlacementStatus::NO_CONNECTION: return "connectors don't sit on sockets";
+        case PlacementStatus::OUT_OF_RANGE: return "coordinates out of range";
+        case PlacementStatus::ROLLED_BACK: return "rolled back";
+        default: return "placed";
+    }
+}
+
+BatchRunner::BatchRunner(Scheme& target, std::ostream& output, std::ostream& errors)
+    : scheme(target), out(output), err(errors), lineNumber(0), errorCount(0) {}
+
+int BatchRunner::run(std::istream& input) {
+    int errorsBefore = errorCount;
+    std::vector<char> buffer(READ_BUFFER_SIZE);
+    std::string carry; // начало строки, не поместившееся в прошлый блок
+    while (input) {
+        input.read(buffer.data(), buffer.size());
+        std::size_t count = static_cast<std::size_t>(input.gcount());
+        std::size_t start = 0;
+        for (std::size_t i = 0; i < count; i++) {
+            if (buffer[i] != '\n') continue;
+            if (carry.empty()) {
+                executeLine(std::string_view(buffer.data() + start, i - start));
+            } else {
+                carry.append(buffer.data() + start, i - start);
+                executeLine(carry);
+                carry.clear();
+            }
+            start = i + 1;
+        }
+        carry.append(buffer.data() + start, count - start);
+    }
+    if (!carry.empty()) {
+        executeLine(carry);
+    }
+    commit();
+    return errorCount - errorsBefore;
+}
+
+void BatchRunner::executeLine(std::string_view line) {
+    lineNumber++;
+    std::size_t comment = line.find('#');
+    if (comment != std::string_view::npos) {
+        line = line.substr(0, comment);
+    }
+
+    tokens.clear();
+    std::size_t pos = 0;
+    while (pos < line.size()) {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t' || line[pos] == '\r')) pos++;
+        std::size_t start = pos;
+        while (pos < line.size() && line[pos] != ' ' && line[pos] != '\t' && line[pos] != '\r') pos++;
+        if (pos > start) {
+            tokens.push_back(line.substr(start, pos - start));
+        }
+    }
+    if (!tokens.empty()) {
+        execute();
+    }
+}
+
+void BatchRunner::execute() {
+    std::string_view command = tokens[0];
+
+    if (command == "place") {
+        int layerIndex, x, y;
+        if (tokens.size() != 5 || !parseInt(tokens[2], layerIndex) ||
+            !parseInt(tokens[3], x) || !parseInt(tokens[4], y)) {
+            error(lineNumber, "usage: place NAME LAYER X Y");
+            return;
+        }
+        auto found = elements.find(std::string(tokens[1]));
+        if (found == elements.end()) {
+            error(lineNumber, "unknown element '" + std::string(tokens[1]) + "'");
+            return;
+        }
+        if (!Layer::fitsCoordinates(x, y, found->second->getWidth(), found->second->getHeight())) {
+            error(lineNumber, "position (" + std::to_string(x) + ", " + std::to_string(y) + ") is out of range");
+            return;
+        }
+        // Слои создаются только командой layer, поэтому номер проверяется сразу
+        if (layerIndex < 0 || layerIndex >= scheme.getLayerCount()) {
+            error(lineNumber, "layer " + std::to_string(layerIndex) + " doesn't exist");
+            return;
+        }
+        pending.push_back(Placement{found->second, layerIndex, x, y});
+        pendingLines.push_back(PendingLine{lineNumber, found->first});
+        if (pending.size() >= MAX_PENDING) {
+            flush();
+        }
+        return;
+    }
+
+    // Остальные команды видят схему со всеми предыдущими размещениями
+    flush();
+
+    if (command == "element" || command == "motor") {
+        defineElement(command == "motor");
+    } else if (command == "layer") {
+        int count = 1;
+        if (tokens.size() > 2 || (tokens.size() == 2 && (!parseInt(tokens[1], count) || count < 1))) {
+            error(lineNumber, "usage: layer [COUNT]");
+            return;
+        }
+        for (int i = 0; i < count; i++) {
+            scheme.createLayer();
+        }
+    } else if (command == "commit") {
+        if (tokens.size() != 1) {
+            error(lineNumber, "usage: commit");
+        }
+    } else if (command == "remove") {
+        int layerIndex, elementIndex;
+        if (tokens.size() != 3 || !parseInt(tokens[1], layerIndex) || !parseInt(tokens[2], elementIndex)) {
+            error(lineNumber, "usage: remove LAYER INDEX");
+            return;
+        }
+        if (layerIndex < 0 || layerIndex >= scheme.getLayerCount() || elementIndex < 0 ||
+            elementIndex >= static_cast<int>(scheme.getLayer(layerIndex)->getElements().size())) {
+            error(lineNumber, "no element " + std::to_string(elementIndex) +
+                              " on layer " + std::to_string(layerIndex));
+            return;
+        }
+        scheme.removeElement(layerIndex, elementIndex);
+    } else if (command == "validate") {
+        // Все нарушения, а не только первое
+        DiagnosticCollector violations;
+        bool valid;
+        {
+            ScopedDiagnosticSink attach(violations);
+            valid = scheme.validateStructure();
+        }
+        if (valid) {
+            out << "valid" << std::endl;
+        }
+        for (const Diagnostic& violation : violations.getDiagnostics()) {
+            out << "invalid: layer " << violation.layerIndex << " element " << violation.elementIndex
+                << " at (" << violation.x << ", " << violation.y << ")" << std::endl;
+        }
+    } else if (command == "display") {
+        std::string frame;
+        scheme.render(frame);
+        out << frame;
+        out.flush();
+    } else if (command == "stats") {
+        scheme.getStats(out);
+    } else if (command == "save" || command == "load") {
+        if (tokens.size() != 2) {
+            error(lineNumber, "usage: " + std::string(command) + " PATH");
+            return;
+        }
+        std::string path(tokens[1]);
+        std::string message;
+        if (command == "save") {
+            if (!saveScheme(scheme, path, &message)) error(lineNumber, message);
+        } else if (loadScheme(path, scheme, &message)) {
+            elements.clear(); // прежние элементы освобождены вместе со старой схемой
+        } else {
+            error(lineNumber, message);
+        }
+    } else {
+        error(lineNumber, "unknown command '" + std::string(command) + "'");
+    }
+}
+
+bool BatchRunner::defineElement(bool isMotor) {
+    // element ИМЯ W H СТРОКИ... / motor ИМЯ W H СКОРОСТЬ НАПР СТРОКИ...
+    size_t rowsStart = isMotor ? 6 : 4;
+    int width, height, speed = 0, direction = 0;
+    if (tokens.size() < rowsStart || !parseInt(tokens[2], width) || !parseInt(tokens[3], height) ||
+        (isMotor && (!parseInt(tokens[4], speed) || !parseInt(tokens[5], direction)))) {
+        error(lineNumber, isMotor ? "usage: motor NAME W H SPEED DIR ROW..."
+                                  : "usage: element NAME W H ROW...");
+        return false;
+    }
+    if (width <= 0 || height <= 0 || tokens.size() - rowsStart != static_cast<size_t>(height)) {
+        error(lineNumber, "expected " + std::to_string(height) + " rows of width " + std::to_string(width));
+        return false;
+    }
+    if (isMotor && (speed < 0 || speed > 100 || direction < 0 || direction > 2)) {
+        error(lineNumber, "motor speed must be 0..100 and direction 0..2");
+        return false;
+    }
+    std::string name(tokens[1]);
+    if (elements.count(name)) {
+        error(lineNumber, "element '" + name + "' already defined");
+        return false;
+    }
+
+    std::vector<std::vector<char>> matrix(height);
+    for (int y = 0; y < height; y++) {
+        std::string_view row = tokens[rowsStart + y];
+        if (row.size() != static_cast<size_t>(width)) {
+            error(lineNumber, "row " + std::to_string(y) + " must have " + std::to_string(width) + " cells");
+            return false;
+        }
+        for (char cell : row) {
+            matrix[y].push_back(cell == '0' || cell == '1' ? cell : ' ');
+        }
+    }
+
+    ElementHandle handle = isMotor ? scheme.createMotor(width, height, matrix, speed, direction)
+                                   : scheme.createElement(width, height, matrix);
+    elements.emplace(name, scheme.getElement(handle));
+    return true;
+}
+
+bool BatchRunner::commit() {
+    return flush();
+}
+
+bool BatchRunner::flush() {
+    if (pending.empty()) {
+        return true;
+    }
+    // Ошибочные строки не мешают остальным размещениям пачки
+    std::vector<PlacementStatus> results;
+    bool allPlaced = scheme.addElements(pending, &results, false);
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i] != PlacementStatus::PLACED) {
+            error(pendingLines[i].line, "cannot place '" + pendingLines[i].name + "': " +
+                                        describeStatus(results[i]));
+        }
+    }
+    pending.clear();
+    pendingLines.clear();
+    return allPlaced;
+}
+
+void BatchRunner::error(int line, const std::string& message) {
+    errorCount++;
+    err << "line " << line << ": " << message << std::endl;
+}
+
+int BatchRunner::getLineNumber() const {
+    return lineNumber;
+}
+
+int BatchRunner::getErrorCount() const {
+    return errorCount;
+}
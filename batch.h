@@ -0,0 +1,69 @@
+// batch.h
+#ifndef BATCH_H
+#define BATCH_H
+
+#include "scheme.h"
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Пакетный режим: команды схемы читаются построчно из файла или канала,
+// без подсказок. Пустые строки и текст после '#' пропускаются.
+//
+//   element ИМЯ W H СТРОКА...            строки матрицы: '1' - соединитель,
+//   motor ИМЯ W H СКОРОСТЬ НАПР СТРОКА...     '0' - гнездо, '.' - пусто
+//   layer [N]                  добавить N слоев (по умолчанию 1)
+//   place ИМЯ СЛОЙ X Y         размещение (копится до конца пачки)
+//   commit                     добавить накопленные размещения
+//   remove СЛОЙ ИНДЕКС         удалить элемент слоя
+//   validate                   проверить структуру
+//   display | stats            вывод схемы и статистики
+//   save ПУТЬ | load ПУТЬ      двоичный файл схемы
+//
+// Размещения накапливаются и добавляются одной пачкой через
+// Scheme::addElements перед любой другой командой и в конце ввода,
+// поэтому проверка пересечений и соединений идет за пачку, а не за строку.
+class BatchRunner {
+private:
+    struct PendingLine {
+        int line;
+        std::string name;
+    };
+
+    Scheme& scheme;
+    std::ostream& out;
+    std::ostream& err;
+    std::unordered_map<std::string, Element*> elements; // элементы по именам
+    std::vector<Placement> pending;
+    std::vector<PendingLine> pendingLines;
+    std::vector<std::string_view> tokens;
+    int lineNumber;
+    int errorCount;
+
+    void error(int line, const std::string& message);
+    void execute();
+    bool defineElement(bool isMotor);
+    bool flush();
+
+public:
+    static const std::size_t READ_BUFFER_SIZE = 1 << 16;
+    static const std::size_t MAX_PENDING = 4096; // размещений в одной пачке
+
+    BatchRunner(Scheme& target, std::ostream& output, std::ostream& errors);
+
+    // Выполняет все команды потока; возвращает число ошибок в нем
+    int run(std::istream& input);
+    // Выполняет одну строку (без перевода строки)
+    void executeLine(std::string_view line);
+    // Добавляет накопленные размещения
+    bool commit();
+
+    int getLineNumber() const;
+    int getErrorCount() const; // за все время работы
+};
+
+#endif // BATCH_H
@@ -0,0 +1,405 @@
+// bench.cpp
+// Набор бенчмарков движка схем. Отдельная программа (без main.cpp):
+//   bench [МАКС_РАЗМЕР] [ФИЛЬТР]
+// Размеры 10, 100, ... до МАКС_РАЗМЕР (по умолчанию 1000000). Каждый
+// результат - одна строка JSON: время на операцию, пропускная способность,
+// выделения памяти на операцию и пиковый RSS процесса.
+#include "element.h"
+#include "layer.h"
+#include "memory.h"
+#include "scheme.h"
+#include "simulation.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+// Подсчет выделений: глобальные operator new/delete этой программы.
+// Не встраиваются: иначе GCC видит malloc в new и free в delete и при -O2
+// предупреждает о несовпадении (-Wmismatched-new-delete)
+static std::atomic<std::uint64_t> allocationCount(0);
+static std::atomic<std::uint64_t> allocatedBytes(0);
+
+__attribute__((noinline)) void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+__attribute__((noinline)) void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+__attribute__((noinline)) void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// Поток, отбрасывающий вывод (для display)
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) override { return c; }
+    std::streamsize xsputn(const char*, std::streamsize count) override { return count; }
+};
+
+// Секундомер: учитывает только замеряемые участки и выделения в них
+class Stopwatch {
+private:
+    std::chrono::steady_clock::time_point started;
+    std::uint64_t allocsAtStart;
+    std::uint64_t bytesAtStart;
+
+public:
+    double totalNs;
+    std::uint64_t ops;
+    std::uint64_t allocs;
+    std::uint64_t bytes;
+
+    Stopwatch() : allocsAtStart(0), bytesAtStart(0), totalNs(0), ops(0), allocs(0), bytes(0) {}
+
+    void start() {
+        allocsAtStart = allocationCount.load(std::memory_order_relaxed);
+        bytesAtStart = allocatedBytes.load(std::memory_order_relaxed);
+        started = std::chrono::steady_clock::now();
+    }
+
+    void stop(std::uint64_t operations) {
+        auto finished = std::chrono::steady_clock::now();
+        totalNs += std::chrono::duration<double, std::nano>(finished - started).count();
+        allocs += allocationCount.load(std::memory_order_relaxed) - allocsAtStart;
+        bytes += allocatedBytes.load(std::memory_order_relaxed) - bytesAtStart;
+        ops += operations;
+    }
+};
+
+// Результат не выбрасывается компилятором
+static volatile std::uint64_t sink = 0;
+
+static const std::vector<std::vector<char>> SOCKET_MATRIX = {{'0', '0'}, {'0', '0'}};
+static const std::vector<std::vector<char>> PEG_MATRIX = {{'1', '1'}, {'1', '1'}};
+static const std::uint32_t SEED = 12345;
+
+// Элементы 2x2 кладутся сеткой почти квадратной формы
+static int gridColumns(int n) {
+    int columns = 1;
+    while (columns * columns < n) columns++;
+    return columns;
+}
+
+static void gridPosition(int i, int columns, int& x, int& y) {
+    x = (i % columns) * 2;
+    y = (i / columns) * 2;
+}
+
+// Нижний слой гнезд и верхний слой соединителей над ними
+static void buildScheme(Scheme& scheme, int n, bool withUpper) {
+    Element* socket = scheme.getElement(scheme.createElement(2, 2, SOCKET_MATRIX));
+    Element* peg = scheme.getElement(scheme.createElement(2, 2, PEG_MATRIX));
+    int columns = gridColumns(n);
+    std::vector<Placement> batch;
+    scheme.createLayer();
+    if (withUpper) scheme.createLayer();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        batch.push_back(Placement{socket, 0, x, y});
+        if (withUpper) batch.push_back(Placement{peg, 1, x, y});
+    }
+    scheme.addElements(batch);
+}
+
+static void benchPlaceElement(int n, Stopwatch& watch) {
+    Element socket(2, 2, SOCKET_MATRIX);
+    int columns = gridColumns(n);
+    Layer layer;
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        layer.placeElement(&socket, x, y);
+    }
+    watch.stop(n);
+}
+
+static void benchHasOverlap(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    const Layer* layer = scheme.getLayer(0);
+    Element probe(3, 3, {{'0', '0', '0'}, {'0', '0', '0'}, {'0', '0', '0'}});
+    std::mt19937 random(SEED);
+    int side = gridColumns(n) * 2 + 4;
+    std::uniform_int_distribution<int> coordinate(-2, side);
+    std::uint64_t hits = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        hits += layer->hasOverlap(&probe, coordinate(random), coordinate(random));
+    }
+    watch.stop(n);
+    sink = sink + hits;
+}
+
+static void benchGetCell(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    const Layer* layer = scheme.getLayer(0);
+    std::mt19937 random(SEED);
+    int side = gridColumns(n) * 2;
+    std::uniform_int_distribution<int> coordinate(0, side);
+    std::uint64_t sockets = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        sockets += layer->getCell(coordinate(random), coordinate(random)) == '0';
+    }
+    watch.stop(n);
+    sink = sink + sockets;
+}
+
+static void benchCanPlaceWithLowerLayer(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    const Layer* lower = scheme.getLayer(0);
+    Layer upper;
+    Element peg(2, 2, PEG_MATRIX);
+    int columns = gridColumns(n);
+    std::uint64_t connected = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        connected += upper.canPlaceWithLowerLayer(&peg, x, y, lower);
+    }
+    watch.stop(n);
+    sink = sink + connected;
+}
+
+static void benchAddElement(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    scheme.createLayer();
+    Element* peg = scheme.getElement(scheme.createElement(2, 2, PEG_MATRIX));
+    int columns = gridColumns(n);
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        scheme.addElement(peg, 1, x, y);
+    }
+    watch.stop(n);
+}
+
+static void benchConnectivity(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    scheme.createLayer();
+    Element* peg = scheme.getElement(scheme.createElement(2, 2, PEG_MATRIX));
+    int columns = gridColumns(n);
+    std::uint64_t connected = scheme.getComponentCount(); // первое построение не замеряется
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        scheme.addElement(peg, 1, x, y);
+        connected += scheme.areConnected(0, i, 1, i);
+    }
+    watch.stop(n);
+    sink = sink + connected;
+}
+
+static void benchAddElements(int n, Stopwatch& watch) {
+    Scheme scheme;
+    watch.start();
+    buildScheme(scheme, n, true);
+    watch.stop(2 * static_cast<std::uint64_t>(n));
+}
+
+static void benchValidateStructure(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, true);
+    // Изменение в обход схемы заставляет проверить все пары слоев целиком
+    Layer* lower = scheme.getLayer(0);
+    lower->placeElement(lower->getElements()[0].first, -10, -10);
+    watch.start();
+    bool valid = scheme.validateStructure();
+    watch.stop(n);
+    sink = sink + valid;
+}
+
+static void benchFindPlacements(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    scheme.createLayer();
+    Element* peg = scheme.getElement(scheme.createElement(2, 2, PEG_MATRIX));
+    std::mt19937 random(SEED);
+    int side = gridColumns(n) * 2;
+    std::uniform_int_distribution<int> coordinate(-32, side);
+    std::uint64_t found = 0;
+    watch.start();
+    for (int i = 0; i < n; i++) {
+        found += scheme.findPlacements(peg, 1, Rect{coordinate(random), coordinate(random), 64, 64}).size();
+    }
+    watch.stop(n);
+    sink = sink + found;
+}
+
+static void benchDisplay(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, false);
+    NullBuffer nullBuffer;
+    std::streambuf* original = std::cout.rdbuf(&nullBuffer);
+    watch.start();
+    scheme.display();
+    watch.stop(n);
+    std::cout.rdbuf(original);
+}
+
+// Один шаг симуляции: 2n узлов, каждый второй столбец гнезд - мотор
+static void benchSimulationTick(int n, Stopwatch& watch) {
+    Scheme scheme;
+    Element* motor = scheme.getElement(scheme.createMotor(2, 2, SOCKET_MATRIX, 30, 1));
+    Element* socket = scheme.getElement(scheme.createElement(2, 2, SOCKET_MATRIX));
+    Element* peg = scheme.getElement(scheme.createElement(2, 2, PEG_MATRIX));
+    int columns = gridColumns(n);
+    std::vector<Placement> batch;
+    scheme.createLayer();
+    scheme.createLayer();
+    for (int i = 0; i < n; i++) {
+        int x, y;
+        gridPosition(i, columns, x, y);
+        batch.push_back(Placement{i % 2 ? socket : motor, 0, x, y});
+        batch.push_back(Placement{peg, 1, x, y});
+    }
+    scheme.addElements(batch);
+    MotorSimulation simulation(scheme);
+    const int TICKS = 100;
+    watch.start();
+    simulation.run(TICKS);
+    watch.stop(TICKS);
+    sink = sink + static_cast<std::uint64_t>(simulation.getAngle(1, 0));
+}
+
+// Групповые команды над n моторами: масштаб скоростей, смена направления
+// работающим, подсчет работающих и остановка всех - одна операция
+static void benchMotorRegistry(int n, Stopwatch& watch) {
+    Scheme scheme;
+    for (int i = 0; i < n; i++) {
+        scheme.createMotor(1, 1, {{'0'}}, 1 + i % 100, 1 + i % 2);
+    }
+    MotorRegistry& motors = scheme.getMotors();
+    watch.start();
+    motors.scaleSpeeds(0.5f);
+    motors.setDirectionWhere([](int, int, bool running) { return running; }, 2);
+    sink = sink + motors.countRunning();
+    motors.stopAll();
+    watch.stop(1);
+}
+
+static void benchCopy(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, true);
+    watch.start();
+    Scheme copy(scheme);
+    watch.stop(1);
+    sink = sink + copy.getLayerCount();
+}
+
+static void benchCopyAndModify(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, true);
+    Element* socket = scheme.getLayer(0)->getElements()[0].first;
+    watch.start();
+    Scheme copy(scheme);
+    copy.addElement(socket, 0, -4, -4); // копия отделяет измененный слой
+    watch.stop(1);
+}
+
+static void benchRemoveElement(int n, Stopwatch& watch) {
+    Scheme scheme;
+    buildScheme(scheme, n, true);
+    watch.start();
+    for (int i = n - 1; i >= 0; i--) {
+        scheme.removeElement(1, i);
+    }
+    watch.stop(n);
+}
+
+struct Benchmark {
+    const char* name;
+    void (*run)(int n, Stopwatch& watch);
+    int maxSize; // выше - слишком долго для одного прогона
+};
+
+static void report(const Benchmark& benchmark, int size, const Stopwatch& watch) {
+    double nsPerOp = watch.ops ? watch.totalNs / watch.ops : 0;
+    std::printf("{\"benchmark\":\"%s\",\"size\":%d,\"ops\":%llu,\"ns_per_op\":%.2f,"
+                "\"ops_per_sec\":%.0f,\"allocs_per_op\":%.3f,\"bytes_per_op\":%.1f,"
+                "\"peak_rss_kb\":%zu}\n",
+                benchmark.name, size, static_cast<unsigned long long>(watch.ops), nsPerOp,
+                nsPerOp > 0 ? 1e9 / nsPerOp : 0.0,
+                watch.ops ? static_cast<double>(watch.allocs) / watch.ops : 0.0,
+                watch.ops ? static_cast<double>(watch.bytes) / watch.ops : 0.0,
+                readProcessMemory().peakKb);
+    std::fflush(stdout);
+}
+
+int main(int argc, char* argv[]) {
+    int maxSize = argc >= 2 ? std::atoi(argv[1]) : 1000000;
+    std::string filter = argc >= 3 ? argv[2] : "";
+
+    const Benchmark benchmarks[] = {
+        {"Layer::placeElement", benchPlaceElement, 1000000},
+        {"Layer::hasOverlap", benchHasOverlap, 1000000},
+        {"Layer::getCell", benchGetCell, 1000000},
+        {"Layer::canPlaceWithLowerLayer", benchCanPlaceWithLowerLayer, 1000000},
+        {"Scheme::addElement", benchAddElement, 1000000},
+        {"Scheme::addElements", benchAddElements, 1000000},
+        {"Scheme::addElement + areConnected", benchConnectivity, 1000000},
+        {"Scheme::validateStructure", benchValidateStructure, 1000000},
+        {"Scheme::findPlacements (64x64)", benchFindPlacements, 100000},
+        {"Scheme::display", benchDisplay, 100000},
+        {"MotorSimulation::tick", benchSimulationTick, 1000000},
+        {"MotorRegistry bulk commands", benchMotorRegistry, 1000000},
+        {"Scheme::Scheme(const Scheme&)", benchCopy, 1000000},
+        {"Scheme copy + first edit", benchCopyAndModify, 1000000},
+        {"Scheme::removeElement", benchRemoveElement, 1000000},
+    };
+
+    // Маленькие размеры повторяются, пока замер не наберет MIN_TIME_NS;
+    // подготовка не замеряется, поэтому общее время ограничено MAX_WALL_TIME
+    const double MIN_TIME_NS = 2e8;
+    const int MAX_REPEATS = 10000;
+    const std::chrono::seconds MAX_WALL_TIME(2);
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!filter.empty() && std::string(benchmark.name).find(filter) == std::string::npos) {
+            continue;
+        }
+        for (int size = 10; size <= maxSize && size <= benchmark.maxSize; size *= 10) {
+            Stopwatch watch;
+            auto deadline = std::chrono::steady_clock::now() + MAX_WALL_TIME;
+            for (int repeat = 0; repeat < MAX_REPEATS && watch.totalNs < MIN_TIME_NS; repeat++) {
+                benchmark.run(size, watch);
+                if (std::chrono::steady_clock::now() > deadline) break;
+            }
+            report(benchmark, size, watch);
+        }
+    }
+    return 0;
+}
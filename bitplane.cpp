@@ -0,0 +1,193 @@
+// bitplane.cpp
+#include "bitplane.h"
+#include <algorithm>
+#include <utility>
+
+const int BitPlane::WORD_BITS;
+
+BitPlane::BitPlane() : width(0), height(0), wordsPerRow(0), words(), external(nullptr) {}
+
+BitPlane::BitPlane(int w, int h) : width(0), height(0), wordsPerRow(0), external(nullptr) {
+    if (w > 0 && h > 0) {
+        width = w;
+        height = h;
+        wordsPerRow = (w + WORD_BITS - 1) / WORD_BITS;
+        words.assign(static_cast<size_t>(wordsPerRow) * height, 0);
+    }
+}
+
+BitPlane::BitPlane(const BitPlane& other)
+    : width(other.width), height(other.height), wordsPerRow(other.wordsPerRow),
+      words(other.getData(), other.getData() + other.getWordCount()), external(nullptr) {}
+
+BitPlane::BitPlane(BitPlane&& other)
+    : width(other.width), height(other.height), wordsPerRow(other.wordsPerRow),
+      words(std::move(other.words)), external(other.external) {
+    other.clear();
+}
+
+BitPlane& BitPlane::operator=(const BitPlane& other) {
+    if (this != &other) {
+        BitPlane copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+BitPlane& BitPlane::operator=(BitPlane&& other) {
+    if (this != &other) {
+        width = other.width;
+        height = other.height;
+        wordsPerRow = other.wordsPerRow;
+        words = std::move(other.words);
+        external = other.external;
+        other.clear();
+    }
+    return *this;
+}
+
+BitPlane BitPlane::view(int w, int h, const std::uint64_t* data) {
+    BitPlane plane;
+    if (w > 0 && h > 0 && data) {
+        plane.width = w;
+        plane.height = h;
+        plane.wordsPerRow = (w + WORD_BITS - 1) / WORD_BITS;
+        plane.external = data;
+    }
+    return plane;
+}
+
+std::size_t BitPlane::getMemoryUsage() const {
+    return words.capacity() * sizeof(std::uint64_t);
+}
+
+bool BitPlane::isView() const {
+    return external != nullptr;
+}
+
+void BitPlane::detach() {
+    if (external) {
+        words.assign(external, external + getWordCount());
+        external = nullptr;
+    }
+}
+
+int BitPlane::getWidth() const { return width; }
+int BitPlane::getHeight() const { return height; }
+int BitPlane::getWordsPerRow() const { return wordsPerRow; }
+
+bool BitPlane::get(int x, int y) const {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return false;
+    }
+    std::uint64_t word = getData()[static_cast<size_t>(y) * wordsPerRow + x / WORD_BITS];
+    return (word >> (x % WORD_BITS)) & 1u;
+}
+
+void BitPlane::set(int x, int y, bool value) {
+    if (x < 0 || x >= width || y < 0 || y >= height) {
+        return;
+    }
+    detach();
+    std::uint64_t& word = words[static_cast<size_t>(y) * wordsPerRow + x / WORD_BITS];
+    std::uint64_t mask = std::uint64_t(1) << (x % WORD_BITS);
+    if (value) {
+        word |= mask;
+    } else {
+        word &= ~mask;
+    }
+}
+
+const std::uint64_t* BitPlane::getRow(int y) const {
+    return getData() + static_cast<size_t>(y) * wordsPerRow;
+}
+
+std::uint64_t* BitPlane::getRow(int y) {
+    detach();
+    return words.data() + static_cast<size_t>(y) * wordsPerRow;
+}
+
+const std::uint64_t* BitPlane::getData() const {
+    return external ? external : words.data();
+}
+
+std::size_t BitPlane::getWordCount() const {
+    return static_cast<size_t>(wordsPerRow) * height;
+}
+
+// Деление с округлением вниз, чтобы работали отрицательные координаты
+static int floorDiv(int value, int divisor) {
+    return (value >= 0) ? value / divisor : -((-value + divisor - 1) / divisor);
+}
+
+std::uint64_t BitPlane::extractBits(int x, int y) const {
+    if (y < 0 || y >= height || x >= width || x + WORD_BITS <= 0) {
+        return 0;
+    }
+    int wordIndex = floorDiv(x, WORD_BITS);
+    int shift = x - wordIndex * WORD_BITS;
+    const std::uint64_t* row = getRow(y);
+
+    std::uint64_t low = (wordIndex >= 0 && wordIndex < wordsPerRow) ? row[wordIndex] : 0;
+    std::uint64_t high = (wordIndex + 1 >= 0 && wordIndex + 1 < wordsPerRow) ? row[wordIndex + 1] : 0;
+    if (shift == 0) {
+        return low;
+    }
+    return (low >> shift) | (high << (WORD_BITS - shift));
+}
+
+void BitPlane::orShifted(std::uint64_t* dst, int dstWords,
+                         const std::uint64_t* src, int srcWords, int offset) {
+    for (int k = 0; k < srcWords; k++) {
+        int position = offset + k * WORD_BITS;
+        if (position >= dstWords * WORD_BITS) break;
+        if (position + WORD_BITS <= 0 || src[k] == 0) continue;
+
+        int wordIndex = floorDiv(position, WORD_BITS);
+        int shift = position - wordIndex * WORD_BITS;
+        if (wordIndex >= 0) {
+            dst[wordIndex] |= src[k] << shift;
+        }
+        if (shift != 0 && wordIndex + 1 < dstWords) {
+            dst[wordIndex + 1] |= src[k] >> (WORD_BITS - shift);
+        }
+    }
+}
+
+void BitPlane::resize(int newWidth, int newHeight) {
+    if (newWidth <= 0 || newHeight <= 0) {
+        clear();
+        return;
+    }
+    BitPlane resized(newWidth, newHeight);
+    int rows = std::min(height, newHeight);
+    int keepWords = std::min(wordsPerRow, resized.wordsPerRow);
+    for (int y = 0; y < rows; y++) {
+        std::copy(getRow(y), getRow(y) + keepWords, resized.getRow(y));
+        // Обнуляем хвост последнего слова, если ширина уменьшилась
+        if (newWidth < width && newWidth % WORD_BITS != 0) {
+            resized.getRow(y)[resized.wordsPerRow - 1] &=
+                (std::uint64_t(1) << (newWidth % WORD_BITS)) - 1;
+        }
+    }
+    *this = std::move(resized);
+}
+
+void BitPlane::clear() {
+    width = height = wordsPerRow = 0;
+    words.clear();
+    external = nullptr;
+}
+
+bool BitPlane::isZero() const {
+    const std::uint64_t* data = getData();
+    for (std::size_t i = 0; i < getWordCount(); i++) {
+        if (data[i] != 0) return false;
+    }
+    return true;
+}
+
+bool BitPlane::operator==(const BitPlane& other) const {
+    return width == other.width && height == other.height &&
+           std::equal(getData(), getData() + getWordCount(), other.getData());
+}
@@ -0,0 +1,66 @@
+// bitplane.h
+#ifndef BITPLANE_H
+#define BITPLANE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Упакованная битовая матрица: строки подряд, 64 клетки в одном слове.
+// Бит (x % 64) слова (x / 64) строки y соответствует клетке (x, y).
+// Биты за пределами ширины всегда нулевые.
+// Матрица может не владеть словами, а смотреть во внешнюю память
+// (например, в отображенный файл); при первом изменении слова копируются.
+class BitPlane {
+private:
+    int width;
+    int height;
+    int wordsPerRow;
+    std::vector<std::uint64_t> words;
+    const std::uint64_t* external; // nullptr, если слова свои
+
+    void detach();
+
+public:
+    static const int WORD_BITS = 64;
+
+    BitPlane(); // Конструктор по умолчанию
+    BitPlane(int w, int h);
+    BitPlane(const BitPlane& other); // Конструктор копирования (всегда свои слова)
+    BitPlane(BitPlane&& other);
+    BitPlane& operator=(const BitPlane& other);
+    BitPlane& operator=(BitPlane&& other);
+
+    // Матрица поверх чужих слов (wordsPerRow * h слов), без копирования
+    static BitPlane view(int w, int h, const std::uint64_t* data);
+    bool isView() const;
+    std::size_t getMemoryUsage() const; // байты собственных слов (у представления - 0)
+
+    int getWidth() const;
+    int getHeight() const;
+    int getWordsPerRow() const;
+
+    bool get(int x, int y) const;
+    void set(int x, int y, bool value);
+
+    // Доступ к строке целиком (getWordsPerRow() слов)
+    const std::uint64_t* getRow(int y) const;
+    std::uint64_t* getRow(int y);
+    const std::uint64_t* getData() const;
+    std::size_t getWordCount() const;
+
+    // 64 клетки строки y, начиная со столбца x (вне матрицы - нули)
+    std::uint64_t extractBits(int x, int y) const;
+
+    // Накладывает (OR) srcWords слов src на dst со сдвигом offset бит
+    // (offset может быть отрицательным, лишние биты отбрасываются)
+    static void orShifted(std::uint64_t* dst, int dstWords,
+                          const std::uint64_t* src, int srcWords, int offset);
+
+    void resize(int newWidth, int newHeight);
+    void clear();
+    bool isZero() const;
+    bool operator==(const BitPlane& other) const;
+};
+
+#endif // BITPLANE_H
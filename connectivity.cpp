@@ -0,0 +1,267 @@
+// connectivity.cpp
+#include "connectivity.h"
+#include <algorithm>
+#include <utility>
+
+// RollbackUnionFind
+
+RollbackUnionFind::RollbackUnionFind() : components(0) {}
+
+int RollbackUnionFind::addNode() {
+    parent.push_back(static_cast<int>(parent.size()));
+    size.push_back(1);
+    components++;
+    return static_cast<int>(parent.size()) - 1;
+}
+
+int RollbackUnionFind::find(int node) const {
+    while (parent[node] != node) {
+        node = parent[node];
+    }
+    return node;
+}
+
+bool RollbackUnionFind::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+        return false;
+    }
+    if (size[a] < size[b]) {
+        std::swap(a, b);
+    }
+    parent[b] = a;
+    size[a] += size[b];
+    history.push_back(b);
+    components--;
+    return true;
+}
+
+int RollbackUnionFind::getNodeCount() const {
+    return static_cast<int>(parent.size());
+}
+
+int RollbackUnionFind::getComponentCount() const {
+    return components;
+}
+
+std::size_t RollbackUnionFind::getHistorySize() const {
+    return history.size();
+}
+
+void RollbackUnionFind::rollback(std::size_t historySize, int nodeCount) {
+    while (history.size() > historySize) {
+        int child = history.back();
+        history.pop_back();
+        size[parent[child]] -= size[child];
+        parent[child] = child;
+        components++;
+    }
+    // Снятые узлы к этому моменту снова одиночные корни
+    components -= static_cast<int>(parent.size()) - nodeCount;
+    parent.resize(nodeCount);
+    size.resize(nodeCount);
+}
+
+void RollbackUnionFind::clear() {
+    parent.clear();
+    size.clear();
+    history.clear();
+    components = 0;
+}
+
+std::size_t RollbackUnionFind::getMemoryUsage() const {
+    return (parent.capacity() + size.capacity() + history.capacity()) * sizeof(int);
+}
+
+// ConnectivityIndex
+
+ConnectivityIndex::ConnectivityIndex() : edgeCount(0), valid(false) {}
+
+void ConnectivityIndex::invalidate() {
+    valid = false;
+}
+
+bool ConnectivityIndex::inSync(const std::vector<Layer*>& layers, int changedLayer,
+                               unsigned long changedVersion) const {
+    if (!valid || layers.size() != knownLayers.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < layers.size(); i++) {
+        unsigned long expected = static_cast<int>(i) == changedLayer ? changedVersion : layers[i]->getVersion();
+        if (layers[i] != knownLayers[i] || knownVersions[i] != expected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Размещения слоя other, чьи клетки expected лежат под клетками cells
+// элемента, стоящего в (x, y); каждое - один раз
+static void findNeighbours(const BitPlane& cells, int x, int y, const Layer* other, char expected,
+                           std::vector<int>& placementIds) {
+    const LayerRaster& raster = other->getRaster();
+    placementIds.clear();
+    for (int cy = 0; cy < cells.getHeight(); cy++) {
+        const std::uint64_t* row = cells.getRow(cy);
+        for (int k = 0; k < cells.getWordsPerRow(); k++) {
+            for (std::uint64_t bits = row[k]; bits; bits &= bits - 1) {
+                int cellX = x + k * BitPlane::WORD_BITS + __builtin_ctzll(bits);
+                if (raster.getCell(cellX, y + cy) == expected) {
+                    placementIds.push_back(raster.getOwner(cellX, y + cy));
+                }
+            }
+        }
+    }
+    std::sort(placementIds.begin(), placementIds.end());
+    placementIds.erase(std::unique(placementIds.begin(), placementIds.end()), placementIds.end());
+}
+
+void collectLinks(const std::vector<Layer*>& layers, std::vector<ElementLink>& out) {
+    out.clear();
+    std::vector<int> placementIds;
+    std::unordered_map<int, int> lowerIndex; // id размещения -> номер в нижнем слое
+    for (std::size_t l = 1; l < layers.size(); l++) {
+        const Layer* lower = layers[l - 1];
+        lowerIndex.clear();
+        for (std::size_t i = 0; i < lower->getElements().size(); i++) {
+            lowerIndex[lower->getPlacementId(static_cast<int>(i))] = static_cast<int>(i);
+        }
+        const auto& elements = layers[l]->getElements();
+        for (std::size_t i = 0; i < elements.size(); i++) {
+            findNeighbours(layers[l]->getPlacedShape(static_cast<int>(i)).getConnectors(), elements[i].second.first,
+                           elements[i].second.second, lower, '0', placementIds);
+            for (int placementId : placementIds) {
+                out.push_back(ElementLink{static_cast<int>(l), static_cast<int>(i), lowerIndex[placementId]});
+            }
+        }
+    }
+}
+
+// Соединяет узел элемента с элементами, на гнездах которых стоят его
+// соединители (нижний слой), и с теми, чьи соединители стоят на его гнездах
+void ConnectivityIndex::connectElement(const std::vector<Layer*>& layers, int layerIndex, int elementIndex,
+                                       bool withLower, bool withUpper) {
+    const Layer* layer = layers[layerIndex];
+    const auto& placed = layer->getElements()[elementIndex];
+    const Shape& shape = layer->getPlacedShape(elementIndex); // соединители на момент размещения
+    int node = nodeOf[layerIndex].at(layer->getPlacementId(elementIndex));
+
+    std::vector<int> placementIds;
+    auto link = [&](int otherIndex) {
+        for (int placementId : placementIds) {
+            auto found = nodeOf[otherIndex].find(placementId);
+            if (found == nodeOf[otherIndex].end()) continue;
+            components.unite(node, found->second);
+            edgeCount++;
+        }
+    };
+    if (withLower && layerIndex > 0) {
+        findNeighbours(shape.getConnectors(), placed.second.first, placed.second.second,
+                       layers[layerIndex - 1], '0', placementIds);
+        link(layerIndex - 1);
+    }
+    if (withUpper && layerIndex + 1 < static_cast<int>(layers.size())) {
+        findNeighbours(shape.getSockets(), placed.second.first, placed.second.second,
+                       layers[layerIndex + 1], '1', placementIds);
+        link(layerIndex + 1);
+    }
+}
+
+void ConnectivityIndex::rebuild(const std::vector<Layer*>& layers) {
+    components.clear();
+    nodeOf.assign(layers.size(), std::unordered_map<int, int>());
+    knownLayers.assign(layers.begin(), layers.end());
+    knownVersions.clear();
+    marks.clear();
+    edgeCount = 0;
+    for (std::size_t l = 0; l < layers.size(); l++) {
+        knownVersions.push_back(layers[l]->getVersion());
+        int count = static_cast<int>(layers[l]->getElements().size());
+        for (int i = 0; i < count; i++) {
+            nodeOf[l][layers[l]->getPlacementId(i)] = components.addNode();
+        }
+    }
+    // Каждое ребро - один раз, со стороны верхнего элемента
+    for (std::size_t l = 1; l < layers.size(); l++) {
+        int count = static_cast<int>(layers[l]->getElements().size());
+        for (int i = 0; i < count; i++) {
+            connectElement(layers, static_cast<int>(l), i, true, false);
+        }
+    }
+    valid = true;
+}
+
+void ConnectivityIndex::sync(const std::vector<Layer*>& layers) {
+    if (!inSync(layers, -1, 0)) {
+        rebuild(layers);
+    }
+}
+
+void ConnectivityIndex::onPlaced(const std::vector<Layer*>& layers, int layerIndex, int elementIndex,
+                                 unsigned long versionBefore) {
+    if (!inSync(layers, layerIndex, versionBefore)) {
+        valid = false;
+        return;
+    }
+    const Layer* layer = layers[layerIndex];
+    int placementId = layer->getPlacementId(elementIndex);
+    marks.push_back(AddMark{layerIndex, placementId, components.getHistorySize(),
+                            components.getNodeCount(), edgeCount});
+    nodeOf[layerIndex][placementId] = components.addNode();
+    connectElement(layers, layerIndex, elementIndex, true, true);
+    knownVersions[layerIndex] = layer->getVersion();
+}
+
+void ConnectivityIndex::onRemoved(const std::vector<Layer*>& layers, int layerIndex, int placementId,
+                                  unsigned long versionBefore) {
+    // Откатить можно только последнее добавление (например, при undo)
+    if (!inSync(layers, layerIndex, versionBefore) || marks.empty() ||
+        marks.back().layerIndex != layerIndex || marks.back().placementId != placementId) {
+        valid = false;
+        return;
+    }
+    const AddMark& mark = marks.back();
+    components.rollback(mark.history, mark.nodes);
+    edgeCount = mark.edges;
+    nodeOf[layerIndex].erase(placementId);
+    marks.pop_back();
+    knownVersions[layerIndex] = layers[layerIndex]->getVersion();
+}
+
+void ConnectivityIndex::onLayerCreated(const std::vector<Layer*>& layers) {
+    if (!valid || layers.size() != knownLayers.size() + 1 || !layers.back()->isEmpty()) {
+        valid = false;
+        return;
+    }
+    nodeOf.push_back(std::unordered_map<int, int>());
+    knownLayers.push_back(layers.back());
+    knownVersions.push_back(layers.back()->getVersion());
+}
+
+int ConnectivityIndex::getComponent(const std::vector<Layer*>& layers, int layerIndex, int elementIndex) const {
+    if (!valid || layerIndex < 0 || layerIndex >= static_cast<int>(layers.size()) || elementIndex < 0 ||
+        elementIndex >= static_cast<int>(layers[layerIndex]->getElements().size())) {
+        return -1;
+    }
+    auto found = nodeOf[layerIndex].find(layers[layerIndex]->getPlacementId(elementIndex));
+    return found == nodeOf[layerIndex].end() ? -1 : components.find(found->second);
+}
+
+int ConnectivityIndex::getComponentCount() const {
+    return components.getComponentCount();
+}
+
+std::size_t ConnectivityIndex::getEdgeCount() const {
+    return edgeCount;
+}
+
+std::size_t ConnectivityIndex::getMemoryUsage() const {
+    std::size_t total = components.getMemoryUsage() + marks.capacity() * sizeof(AddMark) +
+                        knownLayers.capacity() * sizeof(const Layer*) +
+                        knownVersions.capacity() * sizeof(unsigned long);
+    for (const auto& layerNodes : nodeOf) {
+        total += layerNodes.size() * (sizeof(std::pair<const int, int>) + 2 * sizeof(void*));
+    }
+    return total;
+}
@@ -0,0 +1,92 @@
+// connectivity.h
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include "layer.h"
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Соединение: элемент upperElement слоя upperLayer стоит соединителями
+// на гнездах элемента lowerElement слоя upperLayer - 1
+struct ElementLink {
+    int upperLayer;
+    int upperElement;
+    int lowerElement;
+};
+
+// Все соединения слоев (каждое один раз), по слоям и элементам снизу вверх
+void collectLinks(const std::vector<Layer*>& layers, std::vector<ElementLink>& out);
+
+// Система непересекающихся множеств с откатом: объединение по размеру
+// без сжатия путей, поэтому любое объединение можно отменить в обратном порядке
+class RollbackUnionFind {
+private:
+    std::vector<int> parent;
+    std::vector<int> size;
+    std::vector<int> history; // корни, подвешенные к другим корням
+    int components;
+
+public:
+    RollbackUnionFind();
+
+    int addNode();
+    int find(int node) const;
+    bool unite(int a, int b); // false, если уже в одном множестве
+    int getNodeCount() const;
+    int getComponentCount() const;
+    std::size_t getHistorySize() const;
+    // Откатывает объединения до historySize и узлы до nodeCount
+    void rollback(std::size_t historySize, int nodeCount);
+    void clear();
+    std::size_t getMemoryUsage() const;
+};
+
+// Граф соединений элементов схемы: ребро - соединитель ('1') верхнего элемента
+// на гнезде ('0') нижнего. Добавления учитываются сразу, удаление последнего
+// добавленного элемента откатывается; остальные изменения (и правки слоев
+// в обход схемы, видимые по версиям) приводят к перестроению при запросе.
+class ConnectivityIndex {
+private:
+    struct AddMark {
+        int layerIndex;
+        int placementId;
+        std::size_t history;
+        int nodes;
+        std::size_t edges;
+    };
+
+    RollbackUnionFind components;
+    std::vector<std::unordered_map<int, int>> nodeOf; // id размещения -> узел, по слоям
+    std::vector<const Layer*> knownLayers;
+    std::vector<unsigned long> knownVersions;
+    std::vector<AddMark> marks;
+    std::size_t edgeCount;
+    bool valid;
+
+    bool inSync(const std::vector<Layer*>& layers, int changedLayer, unsigned long changedVersion) const;
+    void connectElement(const std::vector<Layer*>& layers, int layerIndex, int elementIndex,
+                        bool withLower, bool withUpper);
+
+public:
+    ConnectivityIndex();
+
+    void rebuild(const std::vector<Layer*>& layers);
+    void invalidate();
+    void sync(const std::vector<Layer*>& layers); // перестраивает, если устарел
+
+    // Вызываются схемой после изменения; versionBefore - версия слоя до него
+    void onPlaced(const std::vector<Layer*>& layers, int layerIndex, int elementIndex,
+                  unsigned long versionBefore);
+    void onRemoved(const std::vector<Layer*>& layers, int layerIndex, int placementId,
+                   unsigned long versionBefore);
+    void onLayerCreated(const std::vector<Layer*>& layers);
+
+    // Запросы к актуальному графу (после sync); -1 для несуществующего элемента
+    int getComponent(const std::vector<Layer*>& layers, int layerIndex, int elementIndex) const;
+    int getComponentCount() const;
+    std::size_t getEdgeCount() const;
+    std::size_t getMemoryUsage() const;
+};
+
+#endif // CONNECTIVITY_H
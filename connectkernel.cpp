@@ -0,0 +1,92 @@
+// connectkernel.cpp
+#include "connectkernel.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    #define CONNECTKERNEL_X86 1
+    #include <immintrin.h>
+#endif
+
+typedef long (*ConnectionKernel)(const std::uint64_t*, const std::uint64_t*, std::size_t);
+
+static long firstViolationScalar(const std::uint64_t* connectors,
+                                 const std::uint64_t* sockets,
+                                 std::size_t count, std::size_t start) {
+    for (std::size_t i = start; i < count; i++) {
+        if ((connectors[i] & ~sockets[i]) != 0) {
+            return static_cast<long>(i);
+        }
+    }
+    return -1;
+}
+
+static long kernelScalar(const std::uint64_t* connectors,
+                         const std::uint64_t* sockets, std::size_t count) {
+    return firstViolationScalar(connectors, sockets, count, 0);
+}
+
+#ifdef CONNECTKERNEL_X86
+
+__attribute__((target("sse2")))
+static long kernelSse2(const std::uint64_t* connectors,
+                       const std::uint64_t* sockets, std::size_t count) {
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(connectors + i));
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sockets + i));
+        __m128i missing = _mm_andnot_si128(s, c);
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(missing, zero)) != 0xFFFF) {
+            break;
+        }
+    }
+    return firstViolationScalar(connectors, sockets, count, i);
+}
+
+__attribute__((target("avx2")))
+static long kernelAvx2(const std::uint64_t* connectors,
+                       const std::uint64_t* sockets, std::size_t count) {
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(connectors + i));
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sockets + i));
+        // testc(s, c) == 1, если (~s & c) == 0
+        if (!_mm256_testc_si256(s, c)) {
+            break;
+        }
+    }
+    return firstViolationScalar(connectors, sockets, count, i);
+}
+
+#endif // CONNECTKERNEL_X86
+
+struct KernelChoice {
+    ConnectionKernel kernel;
+    const char* name;
+};
+
+static KernelChoice chooseKernel() {
+#ifdef CONNECTKERNEL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return KernelChoice{kernelAvx2, "avx2"};
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return KernelChoice{kernelSse2, "sse2"};
+    }
+#endif
+    return KernelChoice{kernelScalar, "scalar"};
+}
+
+static const KernelChoice& getKernel() {
+    static const KernelChoice choice = chooseKernel();
+    return choice;
+}
+
+long findConnectionViolation(const std::uint64_t* connectors,
+                             const std::uint64_t* sockets, std::size_t count) {
+    return getKernel().kernel(connectors, sockets, count);
+}
+
+const char* getConnectionKernelName() {
+    return getKernel().name;
+}
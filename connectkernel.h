@@ -0,0 +1,17 @@
+// connectkernel.h
+#ifndef CONNECTKERNEL_H
+#define CONNECTKERNEL_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Ищет первое слово, в котором есть соединитель без гнезда под ним,
+// т.е. (connectors[i] & ~sockets[i]) != 0. Возвращает индекс слова или -1.
+// Реализация (AVX2, SSE2 или скалярная) выбирается один раз при первом вызове.
+long findConnectionViolation(const std::uint64_t* connectors,
+                             const std::uint64_t* sockets, std::size_t count);
+
+// Название выбранной реализации ("avx2", "sse2" или "scalar")
+const char* getConnectionKernelName();
+
+#endif // CONNECTKERNEL_H
@@ -0,0 +1,73 @@
+// diagnostics.cpp
+#include "diagnostics.h"
+
+namespace diagnostics {
+
+thread_local DiagnosticSink* currentSink = nullptr;
+
+} // namespace diagnostics
+
+const char* getDiagnosticName(DiagnosticCode code) {
+    switch (code) {
+        case DiagnosticCode::LAYER_NOT_FOUND: return "layer not found";
+        case DiagnosticCode::ELEMENT_NOT_FOUND: return "element not found";
+        case DiagnosticCode::INVALID_ELEMENT: return "invalid element";
+        case DiagnosticCode::OVERLAP: return "overlap";
+        case DiagnosticCode::OUT_OF_RANGE: return "coordinates out of range";
+        case DiagnosticCode::NO_CONNECTION: return "no connection";
+        case DiagnosticCode::BROKEN_CONNECTION: return "broken connection";
+        case DiagnosticCode::LAYER_NOT_EMPTY: return "layer not empty";
+        case DiagnosticCode::INVALID_MATRIX_CELL: return "invalid matrix cell";
+        case DiagnosticCode::EMPTY_MATRIX: return "empty matrix";
+        case DiagnosticCode::INVALID_SPEED: return "invalid speed";
+        case DiagnosticCode::INVALID_DIRECTION: return "invalid direction";
+        default: return "?";
+    }
+}
+
+DiagnosticSink::~DiagnosticSink() {}
+
+void DiagnosticCollector::report(const Diagnostic& diagnostic) {
+    std::lock_guard<std::mutex> lock(mutex);
+    diagnostics.push_back(diagnostic);
+}
+
+std::vector<Diagnostic> DiagnosticCollector::getDiagnostics() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return diagnostics;
+}
+
+std::size_t DiagnosticCollector::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return diagnostics.size();
+}
+
+std::size_t DiagnosticCollector::count(DiagnosticCode code) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t result = 0;
+    for (const Diagnostic& diagnostic : diagnostics) {
+        result += diagnostic.code == code;
+    }
+    return result;
+}
+
+void DiagnosticCollector::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    diagnostics.clear();
+}
+
+DiagnosticSink* setDiagnosticSink(DiagnosticSink* sink) {
+    DiagnosticSink* previous = diagnostics::currentSink;
+    diagnostics::currentSink = sink;
+    return previous;
+}
+
+DiagnosticSink* getDiagnosticSink() {
+    return diagnostics::currentSink;
+}
+
+ScopedDiagnosticSink::ScopedDiagnosticSink(DiagnosticSink& sink) : previous(setDiagnosticSink(&sink)) {}
+
+ScopedDiagnosticSink::~ScopedDiagnosticSink() {
+    setDiagnosticSink(previous);
+}
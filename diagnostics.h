@@ -0,0 +1,103 @@
+// diagnostics.h
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+class Element;
+
+// Сообщения ядра об отклоненных операциях и нарушениях структуры.
+// Ядро ничего не печатает: диагностика уходит в приемник, подключенный
+// к текущему потоку, а без приемника не формируется вовсе (одна проверка
+// указателя). Печатает консольный интерфейс своим приемником.
+
+enum class DiagnosticCode
+{
+    LAYER_NOT_FOUND,     // layerIndex
+    ELEMENT_NOT_FOUND,   // layerIndex, elementIndex
+    INVALID_ELEMENT,     // пустой указатель на элемент
+    OVERLAP,             // layerIndex, (x, y) - куда ставили
+    OUT_OF_RANGE,        // layerIndex, (x, y) - угол вне Layer::MIN_COORDINATE..MAX_COORDINATE
+    NO_CONNECTION,       // layerIndex (-1 вне схемы), (x, y) - соединитель без гнезда
+    BROKEN_CONNECTION,   // проверка структуры: layerIndex, elementIndex, (x, y) - как выше
+    LAYER_NOT_EMPTY,     // удаление непустого слоя из-под верхних
+    INVALID_MATRIX_CELL, // (x, y) клетки, value - ее символ
+    EMPTY_MATRIX,
+    INVALID_SPEED,       // value - скорость
+    INVALID_DIRECTION,   // value - направление
+    COUNT,
+};
+
+struct Diagnostic {
+    DiagnosticCode code;
+    int layerIndex;   // -1, если не относится к слою
+    int elementIndex; // -1, если не относится к размещению
+    int x;
+    int y;
+    int value;
+    const Element* element; // элемент операции, если есть
+};
+
+const char* getDiagnosticName(DiagnosticCode code);
+
+class DiagnosticSink {
+public:
+    virtual ~DiagnosticSink();
+    virtual void report(const Diagnostic& diagnostic) = 0;
+};
+
+// Собирает все сообщения; можно подключать к нескольким потокам сразу
+class DiagnosticCollector : public DiagnosticSink {
+private:
+    mutable std::mutex mutex;
+    std::vector<Diagnostic> diagnostics;
+
+public:
+    void report(const Diagnostic& diagnostic) override;
+
+    std::vector<Diagnostic> getDiagnostics() const; // в порядке поступления
+    std::size_t size() const;
+    std::size_t count(DiagnosticCode code) const;
+    void clear();
+};
+
+// Приемник текущего потока (nullptr - диагностика выключена);
+// возвращает предыдущий
+DiagnosticSink* setDiagnosticSink(DiagnosticSink* sink);
+DiagnosticSink* getDiagnosticSink();
+
+// Подключает приемник к потоку на время жизни объекта
+class ScopedDiagnosticSink {
+private:
+    DiagnosticSink* previous;
+
+public:
+    explicit ScopedDiagnosticSink(DiagnosticSink& sink);
+    ScopedDiagnosticSink(const ScopedDiagnosticSink&) = delete;
+    ScopedDiagnosticSink& operator=(const ScopedDiagnosticSink&) = delete;
+    ~ScopedDiagnosticSink();
+};
+
+namespace diagnostics {
+
+extern thread_local DiagnosticSink* currentSink;
+
+} // namespace diagnostics
+
+// Подключен ли приемник: дорогие отчеты (например, все нарушения
+// вместо первого) собираются только тогда
+inline bool diagnosticsEnabled() {
+    return diagnostics::currentSink != nullptr;
+}
+
+inline void reportDiagnostic(DiagnosticCode code, int layerIndex = -1, int elementIndex = -1,
+                             int x = 0, int y = 0, int value = 0, const Element* element = nullptr) {
+    DiagnosticSink* sink = diagnostics::currentSink;
+    if (sink) {
+        sink->report(Diagnostic{code, layerIndex, elementIndex, x, y, value, element});
+    }
+}
+
+#endif // DIAGNOSTICS_H
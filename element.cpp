@@ -1,93 +1,342 @@
 // element.cpp
 #include "element.h"
-#include <iostream>
+#include "diagnostics.h"
+#include "motorregistry.h"
+#include <algorithm>
 
 // Element
 
-Element::Element() : width(0), height(0), matrix() {}
+struct Element::Variants
+{
+    std::atomic<Element *> elements[ORIENTATION_COUNT];
+    Variants *previous; // следующий в списке отложенных наборов
+};
+
+void Element::deleteVariants(Variants *set)
+{
+    while (set)
+    {
+        for (std::atomic<Element *> &variant : set->elements)
+        {
+            delete variant.load();
+        }
+        Variants *previous = set->previous;
+        delete set;
+        set = previous;
+    }
+}
+
+Element::Element() : variants(nullptr), retiredVariants(nullptr)
+{
+    assignShape(0, 0, BitPlane(), BitPlane());
+}
 
 Element::Element(int w, int h, const std::vector<std::vector<char>> &mat)
+    : variants(nullptr), retiredVariants(nullptr)
 {
     if (w > 0 && h > 0) {
-        width = w;
-        height = h;
-        matrix = mat;
+        fillPlanes(w, h, mat);
+    } else {
+        assignShape(0, 0, BitPlane(), BitPlane());
+    }
+}
+
+Element::Element(const Element &other) : shape(other.shape), variants(nullptr), retiredVariants(nullptr) {}
+
+Element::Element(const std::shared_ptr<const Shape> &sharedShape)
+    : shape(sharedShape), variants(nullptr), retiredVariants(nullptr)
+{
+    if (!shape)
+    {
+        assignShape(0, 0, BitPlane(), BitPlane());
+    }
+}
+
+Element &Element::operator=(const Element &other)
+{
+    if (this != &other)
+    {
+        shape = other.shape;
+        updateVariants();
+    }
+    return *this;
+}
+
+Element::~Element()
+{
+    deleteVariants(variants.load());
+    deleteVariants(retiredVariants);
+}
+
+void Element::assignShape(int w, int h, const BitPlane &occupancy, const BitPlane &connectors)
+{
+    shape = ShapeRegistry::instance().intern(w, h, occupancy, connectors);
+    updateVariants();
+}
+
+// Уже выданные варианты не меняются: они стоят на слоях со старой формой.
+// Их набор откладывается, а следующие getOriented создают новые варианты
+void Element::updateVariants()
+{
+    Variants *created = variants.exchange(nullptr);
+    if (!created)
+    {
+        return;
+    }
+    created->previous = retiredVariants;
+    retiredVariants = created;
+}
+
+Element *Element::createVariant(const std::shared_ptr<const Shape> &variantShape) const
+{
+    return new Element(variantShape);
+}
+
+bool Element::isSameOrVariant(const Element *other) const
+{
+    if (other == this)
+    {
+        return true;
+    }
+    auto inList = [other](const Variants *set)
+    {
+        for (; set; set = set->previous)
+        {
+            for (const std::atomic<Element *> &variant : set->elements)
+            {
+                if (variant.load(std::memory_order_acquire) == other)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    };
+    return inList(variants.load(std::memory_order_acquire)) || inList(retiredVariants);
+}
+
+Element *Element::getOriented(Orientation o) const
+{
+    int slot = static_cast<int>(o);
+    if (slot == 0)
+    {
+        return const_cast<Element *>(this);
+    }
+    // Без блокировок: проигравший гонку поток удаляет свою копию
+    Variants *created = variants.load(std::memory_order_acquire);
+    if (!created)
+    {
+        Variants *fresh = new Variants();
+        for (std::atomic<Element *> &variant : fresh->elements)
+        {
+            variant.store(nullptr, std::memory_order_relaxed);
+        }
+        fresh->previous = nullptr;
+        if (variants.compare_exchange_strong(created, fresh, std::memory_order_acq_rel))
+        {
+            created = fresh;
+        }
+        else
+        {
+            delete fresh;
+        }
+    }
+    Element *variant = created->elements[slot].load(std::memory_order_acquire);
+    if (!variant)
+    {
+        Element *fresh = createVariant(shape->getOriented(o));
+        if (created->elements[slot].compare_exchange_strong(variant, fresh, std::memory_order_acq_rel))
+        {
+            variant = fresh;
+        }
+        else
+        {
+            delete fresh;
+        }
     }
+    return variant;
 }
 
-Element::Element(const Element &other)
+std::vector<Orientation> Element::getDistinctOrientations() const
 {
-    width = other.width;
-    height = other.height;
-    matrix = other.matrix;
+    std::vector<Orientation> distinct;
+    std::vector<const Shape *> seen;
+    for (int o = 0; o < ORIENTATION_COUNT; o++)
+    {
+        const Shape *oriented = &getOriented(static_cast<Orientation>(o))->getShape();
+        if (std::find(seen.begin(), seen.end(), oriented) == seen.end())
+        {
+            seen.push_back(oriented);
+            distinct.push_back(static_cast<Orientation>(o));
+        }
+    }
+    return distinct;
+}
+
+void Element::fillPlanes(int w, int h, const std::vector<std::vector<char>> &mat)
+{
+    BitPlane occupancy(w, h);
+    BitPlane connectors(w, h);
+    int rows = std::min<int>(h, mat.size());
+    for (int y = 0; y < rows; y++)
+    {
+        int cols = std::min<int>(w, mat[y].size());
+        for (int x = 0; x < cols; x++)
+        {
+            char cell = mat[y][x];
+            if (cell == '0' || cell == '1')
+            {
+                occupancy.set(x, y, true);
+                connectors.set(x, y, cell == '1');
+            }
+        }
+    }
+    assignShape(w, h, occupancy, connectors);
 }
 
 int Element::getWidth() const
 {
-    return width;
+    return shape->getWidth();
 }
 
 int Element::getHeight() const
 {
-    return height;
+    return shape->getHeight();
 }
 
 char Element::getCell(int x, int y) const
 {
-    if (x >= 0 && x < width && y >= 0 && y < height)
+    if (shape->getOccupancy().get(x, y))
     {
-        return matrix[y][x];
+        return shape->getConnectors().get(x, y) ? '1' : '0';
     }
     return ' ';
 }
 
-const std::vector<std::vector<char>> &Element::getMatrix() const
+std::vector<std::vector<char>> Element::getMatrix() const
 {
+    int width = getWidth();
+    int height = getHeight();
+    std::vector<std::vector<char>> matrix(height, std::vector<char>(width, ' '));
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            matrix[y][x] = getCell(x, y);
+        }
+    }
     return matrix;
 }
 
+int Element::getRowWords() const
+{
+    return shape->getOccupancy().getWordsPerRow();
+}
+
+const std::uint64_t *Element::getOccupancyRow(int y) const
+{
+    return shape->getOccupancy().getRow(y);
+}
+
+const std::uint64_t *Element::getConnectorRow(int y) const
+{
+    return shape->getConnectors().getRow(y);
+}
+
+const BitPlane &Element::getOccupancy() const
+{
+    return shape->getOccupancy();
+}
+
+const BitPlane &Element::getConnectors() const
+{
+    return shape->getConnectors();
+}
+
+const BitPlane &Element::getSockets() const
+{
+    return shape->getSockets();
+}
+
+const Shape &Element::getShape() const
+{
+    return *shape;
+}
+
+const std::shared_ptr<const Shape> &Element::getShapePtr() const
+{
+    return shape;
+}
+
+int Element::getShapeId() const
+{
+    return shape->getId();
+}
+
+bool Element::hasSameShape(const Element &other) const
+{
+    return shape == other.shape;
+}
+
+// Форма неизменяема: модификаторы собирают новые матрицы и регистрируют их
+
 void Element::setWidth(int newWidth)
 {
     if (newWidth > 0)
-        width = newWidth;
+    {
+        BitPlane occupancy(shape->getOccupancy());
+        BitPlane connectors(shape->getConnectors());
+        occupancy.resize(newWidth, getHeight());
+        connectors.resize(newWidth, getHeight());
+        assignShape(newWidth, getHeight(), occupancy, connectors);
+    }
 }
 
 void Element::setHeight(int newHeight)
 {
     if (newHeight > 0)
-        height = newHeight;
+    {
+        BitPlane occupancy(shape->getOccupancy());
+        BitPlane connectors(shape->getConnectors());
+        occupancy.resize(getWidth(), newHeight);
+        connectors.resize(getWidth(), newHeight);
+        assignShape(getWidth(), newHeight, occupancy, connectors);
+    }
 }
 
 void Element::setCell(int x, int y, char value)
 {
-    if (x >= 0 && x < width && y >= 0 && y < height && (value == '0' || value == '1'))
+    if (x >= 0 && x < getWidth() && y >= 0 && y < getHeight() && (value == '0' || value == '1'))
     {
-        matrix[y][x] = value;
+        BitPlane occupancy(shape->getOccupancy());
+        BitPlane connectors(shape->getConnectors());
+        occupancy.set(x, y, true);
+        connectors.set(x, y, value == '1');
+        assignShape(getWidth(), getHeight(), occupancy, connectors);
     }
 }
 
 void Element::setMatrix(const std::vector<std::vector<char>> &newMatrix)
 {
-    for (const std::vector<char> &row : newMatrix)
+    for (int y = 0; y < static_cast<int>(newMatrix.size()); y++)
     {
-        for (const char &cell : row)
+        for (int x = 0; x < static_cast<int>(newMatrix[y].size()); x++)
         {
+            char cell = newMatrix[y][x];
             if (cell != '0' && cell != '1')
             {
-                std::cout << "Error: Matrix can only contain '0' or '1'" << std::endl;
+                reportDiagnostic(DiagnosticCode::INVALID_MATRIX_CELL, -1, -1, x, y, cell, this);
                 return;
             }
         }
     }
     if (!newMatrix.empty() && !newMatrix[0].empty())
     {
-        matrix = newMatrix;
-        height = newMatrix.size();
-        width = newMatrix[0].size();
+        fillPlanes(newMatrix[0].size(), newMatrix.size(), newMatrix);
     }
     else
     {
-        std::cout << "Empty matrix" << std::endl;
+        reportDiagnostic(DiagnosticCode::EMPTY_MATRIX, -1, -1, 0, 0, 0, this);
     }
 }
 
@@ -98,19 +347,62 @@ ElementType Element::getType() const
 
 // Motor
 
-Motor::Motor() : Element(), speed(0), isRotating(false), direction(0) {}
+Motor::Motor() : Element(), speed(0), isRotating(false), direction(0), registry(nullptr), slot(0) {}
 
 Motor::Motor(int w, int h, const std::vector<std::vector<char>> &mat,
-             int spd, int dir) : Element(w, h, mat), speed(spd), direction(dir)
+             int spd, int dir) : Element(w, h, mat), speed(spd), direction(dir), registry(nullptr), slot(0)
+{
+    isRotating = (speed > 0);
+}
+
+Motor::Motor(const std::shared_ptr<const Shape> &sharedShape, int spd, int dir)
+    : Element(sharedShape), speed(spd), direction(dir), registry(nullptr), slot(0)
 {
     isRotating = (speed > 0);
 }
 
 Motor::Motor(const Motor &other) : Element(other),
-                                   speed(other.speed),
-                                   isRotating(other.isRotating),
-                                   direction(other.direction)
+                                   speed(other.getSpeed()),
+                                   isRotating(other.getStatus()),
+                                   direction(other.getDirection()),
+                                   registry(nullptr),
+                                   slot(0)
+{
+}
+
+Motor &Motor::operator=(const Motor &other)
+{
+    if (this != &other)
+    {
+        Element::operator=(other);
+        int newSpeed = other.getSpeed();
+        int newDirection = other.getDirection();
+        bool newStatus = other.getStatus();
+        if (registry)
+        {
+            registry->speeds[slot] = newSpeed;
+            registry->directions[slot] = static_cast<std::int8_t>(newDirection);
+            registry->running[slot] = newStatus ? 1 : 0;
+        }
+        else
+        {
+            speed = newSpeed;
+            direction = newDirection;
+            isRotating = newStatus;
+        }
+    }
+    return *this;
+}
+
+// Повернутая копия мотора из реестра смотрит в ту же ячейку,
+// отдельного - получает копию состояния
+Element *Motor::createVariant(const std::shared_ptr<const Shape> &variantShape) const
 {
+    Motor *variant = new Motor(variantShape, speed, direction);
+    variant->isRotating = isRotating;
+    variant->registry = registry;
+    variant->slot = slot;
+    return variant;
 }
 
 ElementType Motor::getType() const
@@ -122,31 +414,49 @@ void Motor::setSpeed(int newSpeed)
 {
     if ((newSpeed >= 0) && (newSpeed <= 100))
     {
-        speed = newSpeed;
+        if (registry)
+        {
+            registry->speeds[slot] = newSpeed;
+        }
+        else
+        {
+            speed = newSpeed;
+        }
     }
 }
 
 int Motor::getSpeed() const
 {
-    return speed;
+    return registry ? registry->speeds[slot] : speed;
 }
 
 void Motor::setDirection(int newDirection)
 {
     if (newDirection == 1 || newDirection == 2 || newDirection == 0)
     {
-        direction = newDirection;
+        if (registry)
+        {
+            registry->directions[slot] = static_cast<std::int8_t>(newDirection);
+        }
+        else
+        {
+            direction = newDirection;
+        }
     }
 }
 
 int Motor::getDirection() const
 {
-    return direction;
+    return registry ? registry->directions[slot] : direction;
 }
 
 void Motor::setStatus(bool newStatus)
 {
-    if (newStatus == true || newStatus == false)
+    if (registry)
+    {
+        registry->running[slot] = newStatus ? 1 : 0;
+    }
+    else
     {
         isRotating = newStatus;
     }
@@ -154,42 +464,43 @@ void Motor::setStatus(bool newStatus)
 
 bool Motor::getStatus() const
 {
-    return isRotating;
+    return registry ? registry->running[slot] != 0 : isRotating;
+}
+
+const MotorRegistry *Motor::getRegistry() const
+{
+    return registry;
+}
+
+std::uint32_t Motor::getRegistrySlot() const
+{
+    return slot;
 }
 
 void Motor::rotate(int newSpeed, int newDirection)
 {
-    std::cout << "Enter speed: " << std::endl;
     if ((newSpeed > 0) && (newSpeed <= 100))
     {
-        speed = newSpeed;
-        isRotating = true;
+        setSpeed(newSpeed);
+        setStatus(true);
     }
     else
     {
-        std::cout << "Error: Incorrect speed value!" << std::endl;
-    }
-    std::cout << "Enter direction" << std::endl;
-    if (newDirection == 1)
-    {
-        direction = newDirection;
-        std::cout << "Motor is moving with " << newSpeed << " speed in clockwise direction" << std::endl;
+        reportDiagnostic(DiagnosticCode::INVALID_SPEED, -1, -1, 0, 0, newSpeed, this);
     }
-    else if (newDirection == 2)
+    if (newDirection == 1 || newDirection == 2)
     {
-        direction = newDirection;
-        std::cout << "Motor is moving with " << newSpeed << " speed in counterclockwise direction" << std::endl;
+        setDirection(newDirection);
     }
     else
     {
-        std::cout << "Error: Incorrect direction!" << std::endl;
+        reportDiagnostic(DiagnosticCode::INVALID_DIRECTION, -1, -1, 0, 0, newDirection, this);
     }
 }
 
 void Motor::stop()
 {
-    speed = 0;
-    isRotating = false;
-    direction = 0;
-    std::cout << "Motor has been stopped!" << std::endl;
+    setSpeed(0);
+    setStatus(false);
+    setDirection(0);
 }
@@ -2,8 +2,15 @@
 #ifndef ELEMENT_H
 #define ELEMENT_H
 
+#include "bitplane.h"
+#include "shape.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
+class MotorRegistry;
+
 enum class ElementType
 {
     ELEMENT,
@@ -15,20 +22,61 @@ enum class ElementType
 class Element
 {
 private:
-    int width;
-    int height;
-    std::vector<std::vector<char>> matrix;
+    // Общая неизменяемая форма: занятые клетки и соединители ('1')
+    std::shared_ptr<const Shape> shape;
+
+    // Повернутые копии элемента, создаются при первом запросе
+    struct Variants;
+    mutable std::atomic<Variants*> variants;
+    // Наборы, выданные до смены формы: на них ссылаются слои,
+    // поэтому они живут до удаления элемента
+    Variants *retiredVariants;
+
+    static void deleteVariants(Variants *set); // вместе с отложенными после него
+
+    void assignShape(int w, int h, const BitPlane &occupancy, const BitPlane &connectors);
+    void fillPlanes(int w, int h, const std::vector<std::vector<char>> &mat);
+    void updateVariants();
+
+protected:
+    // Новый элемент того же вида (и состояния) с другой формой
+    virtual Element *createVariant(const std::shared_ptr<const Shape> &variantShape) const;
 
 public:
     Element(); // Конструктор по умолчанию
     Element(int w, int h, const std::vector<std::vector<char>> &mat);
     Element(const Element &other); // Конструктор копирования
+    explicit Element(const std::shared_ptr<const Shape> &sharedShape);
+    Element &operator=(const Element &other);
 
     // Селекторы (геттеры)
     int getWidth() const;
     int getHeight() const;
     char getCell(int x, int y) const;
-    const std::vector<std::vector<char>> &getMatrix() const;
+    std::vector<std::vector<char>> getMatrix() const;
+
+    // Построчный доступ к упакованным матрицам (getRowWords() слов на строку)
+    int getRowWords() const;
+    const std::uint64_t *getOccupancyRow(int y) const;
+    const std::uint64_t *getConnectorRow(int y) const;
+    const BitPlane &getOccupancy() const;
+    const BitPlane &getConnectors() const;
+    const BitPlane &getSockets() const;
+
+    // Форма элемента (одинаковые матрицы - один объект Shape)
+    const Shape &getShape() const;
+    const std::shared_ptr<const Shape> &getShapePtr() const;
+    int getShapeId() const;
+    bool hasSameShape(const Element &other) const;
+
+    // Элемент в ориентации o: создается один раз и живет, пока жив этот
+    // элемент, поэтому его можно размещать на слоях как обычный.
+    // Для R0 возвращается сам элемент
+    Element *getOriented(Orientation o) const;
+    // other - сам элемент или одна из выданных им копий (и до смены формы)
+    bool isSameOrVariant(const Element *other) const;
+    // Ориентации, дающие разные формы (для симметричных элементов меньше 8)
+    std::vector<Orientation> getDistinctOrientations() const;
 
     // Модификаторы (сеттеры)
     void setWidth(int newWidth);
@@ -38,7 +86,7 @@ public:
 
     // Виртуальный метод идентификации
     virtual ElementType getType() const;
-    virtual ~Element() = default; // Деструктор по умолчанию
+    virtual ~Element();
 };
 
 class Motor : public Element
@@ -48,12 +96,26 @@ private:
     bool isRotating;
     int direction;
 
+    // Мотор хранилища - представление ячейки реестра: состояние лежит там,
+    // а поля выше не используются
+    MotorRegistry *registry;
+    std::uint32_t slot;
+
+    friend class MotorRegistry;
+
 public:
     Motor(); // Конструктор по умолчанию
     Motor(int w, int h, const std::vector<std::vector<char>> &mat,
           int spd = 0, int dir = 0);
-    Motor(const Motor &other); // Конструктор копирования
+    Motor(const Motor &other); // Конструктор копирования (копия не в реестре)
+    Motor(const std::shared_ptr<const Shape> &sharedShape, int spd, int dir);
+    Motor &operator=(const Motor &other); // копирует форму и состояние
 
+protected:
+    // Повернутый мотор получает текущие скорость, направление и состояние
+    virtual Element *createVariant(const std::shared_ptr<const Shape> &variantShape) const;
+
+public:
     // Перегрузка виртуального метода идентификации
     virtual ElementType getType() const;
     
@@ -65,6 +127,10 @@ public:
     void setStatus(bool newStatus);
     bool getStatus() const;
 
+    // Реестр, в котором лежит состояние (nullptr для отдельного мотора), и ячейка в нем
+    const MotorRegistry *getRegistry() const;
+    std::uint32_t getRegistrySlot() const;
+
     // Методы уникальные
     void rotate(int newSpeed, int newDirection);
     void stop();
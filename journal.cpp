@@ -0,0 +1,179 @@
+// journal.cpp
+#include "journal.h"
+#include <algorithm>
+
+const std::size_t EditJournal::DEFAULT_HISTORY_LIMIT;
+
+EditJournal::EditJournal(SpatialIndexType type)
+    : undoSteps(0), redoSteps(0), historyLimit(DEFAULT_HISTORY_LIMIT),
+      transactionDepth(0), transactionRecords(0), indexType(type), hasCheckpoint(false) {}
+
+void EditJournal::record(EditRecord edit) {
+    edit.stepStart = transactionDepth == 0 || transactionRecords == 0;
+    if (edit.stepStart) {
+        while (undoSteps >= historyLimit) {
+            collapseOldestStep();
+        }
+        undoSteps++;
+    }
+    if (transactionDepth > 0) {
+        transactionRecords++;
+    }
+    undoLog.push_back(std::move(edit));
+    // Новая правка отменяет возможность повторить отмененные
+    redoLog.clear();
+    redoSteps = 0;
+}
+
+void EditJournal::collapseOldestStep() {
+    do {
+        const EditRecord& edit = undoLog.front();
+        if (hasCheckpoint) {
+            // Правка применяется к точке отката - она сдвигается вперед
+            switch (edit.type) {
+                case EditType::ADD_ELEMENT:
+                    checkpointLayers[edit.layerIndex].placeElement(edit.elem, edit.x, edit.y);
+                    break;
+                case EditType::REMOVE_ELEMENT:
+                    checkpointLayers[edit.layerIndex].removeElement(edit.elementIndex);
+                    break;
+                case EditType::CREATE_LAYER:
+                    checkpointLayers.push_back(Layer(indexType));
+                    break;
+                case EditType::REMOVE_LAYER:
+                    checkpointLayers.erase(checkpointLayers.begin() + edit.layerIndex);
+                    break;
+            }
+        }
+        undoLog.pop_front();
+    } while (!undoLog.empty() && !undoLog.front().stepStart);
+    undoSteps--;
+}
+
+void EditJournal::beginTransaction() {
+    if (transactionDepth == 0) {
+        transactionRecords = 0;
+    }
+    transactionDepth++;
+}
+
+bool EditJournal::commitTransaction() {
+    if (transactionDepth == 0) {
+        return false;
+    }
+    transactionDepth--;
+    return true;
+}
+
+bool EditJournal::inTransaction() const {
+    return transactionDepth > 0;
+}
+
+bool EditJournal::takeUndoStep(std::vector<EditRecord>& step) {
+    step.clear();
+    if (undoSteps == 0 || transactionDepth > 0) {
+        return false;
+    }
+    bool stepStart;
+    do {
+        stepStart = undoLog.back().stepStart;
+        step.push_back(undoLog.back());
+        redoLog.push_back(std::move(undoLog.back()));
+        undoLog.pop_back();
+    } while (!stepStart);
+    undoSteps--;
+    redoSteps++;
+    return true;
+}
+
+bool EditJournal::takeRedoStep(std::vector<EditRecord>& step) {
+    step.clear();
+    if (redoSteps == 0 || transactionDepth > 0) {
+        return false;
+    }
+    do {
+        step.push_back(redoLog.back());
+        undoLog.push_back(std::move(redoLog.back()));
+        redoLog.pop_back();
+    } while (!redoLog.empty() && !redoLog.back().stepStart);
+    redoSteps--;
+    undoSteps++;
+    return true;
+}
+
+void EditJournal::takeTransaction(std::vector<EditRecord>& step) {
+    step.clear();
+    for (std::size_t i = 0; i < transactionRecords; i++) {
+        step.push_back(std::move(undoLog.back()));
+        undoLog.pop_back();
+    }
+    if (transactionRecords > 0) {
+        undoSteps--;
+    }
+    transactionRecords = 0;
+    transactionDepth = 0;
+}
+
+void EditJournal::setHistoryLimit(std::size_t steps) {
+    historyLimit = steps > 0 ? steps : 1;
+    // Открытая транзакция не сворачивается
+    while (undoSteps > historyLimit && undoLog.size() > transactionRecords) {
+        collapseOldestStep();
+    }
+}
+
+std::size_t EditJournal::getHistoryLimit() const {
+    return historyLimit;
+}
+
+std::size_t EditJournal::getUndoSteps() const {
+    return undoSteps;
+}
+
+std::size_t EditJournal::getRedoSteps() const {
+    return redoSteps;
+}
+
+std::size_t EditJournal::getMemoryUsage() const {
+    return undoLog.size() * sizeof(EditRecord) + redoLog.capacity() * sizeof(EditRecord) +
+           checkpointLayers.capacity() * sizeof(Layer);
+}
+
+void EditJournal::setCheckpoint(const std::vector<Layer*>& layers) {
+    checkpointLayers.clear();
+    for (const Layer* layer : layers) {
+        checkpointLayers.push_back(*layer);
+    }
+    hasCheckpoint = true;
+    clear();
+}
+
+const std::vector<Layer>* EditJournal::getCheckpoint() const {
+    return hasCheckpoint ? &checkpointLayers : nullptr;
+}
+
+bool EditJournal::referencesElement(const Element* elem) const {
+    auto recorded = [elem](const EditRecord& edit) {
+        return (edit.elem && elem->isSameOrVariant(edit.elem)) ||
+               (edit.layer && edit.layer->containsElement(elem));
+    };
+    if (std::any_of(undoLog.begin(), undoLog.end(), recorded) ||
+        std::any_of(redoLog.begin(), redoLog.end(), recorded)) {
+        return true;
+    }
+    for (const Layer& layer : checkpointLayers) {
+        if (layer.containsElement(elem)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void EditJournal::clear() {
+    undoLog.clear();
+    redoLog.clear();
+    undoSteps = 0;
+    redoSteps = 0;
+    transactionDepth = 0;
+    transactionRecords = 0;
+}
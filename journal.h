@@ -0,0 +1,84 @@
+// journal.h
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include "layer.h"
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+enum class EditType
+{
+    ADD_ELEMENT,    // элемент добавлен в конец слоя
+    REMOVE_ELEMENT, // элемент удален с позиции elementIndex
+    CREATE_LAYER,   // слой добавлен сверху
+    REMOVE_LAYER,   // слой layerIndex удален
+};
+
+// Одна правка схемы: по ней однозначно выполняется и обратная операция
+struct EditRecord {
+    EditType type;
+    bool stepStart; // первая правка шага отмены
+    int layerIndex;
+    int elementIndex;
+    Element* elem;
+    int x;
+    int y;
+    std::shared_ptr<const Layer> layer; // удаленный слой (содержимое общее, без копии)
+};
+
+// Журнал правок: шаги для undo/redo, транзакции и точка отката.
+// Сами правки применяет Scheme; журнал только хранит их.
+class EditJournal {
+private:
+    std::deque<EditRecord> undoLog;
+    std::vector<EditRecord> redoLog; // последний шаг - в конце, начало шага сверху
+    std::size_t undoSteps;
+    std::size_t redoSteps;
+    std::size_t historyLimit;
+    int transactionDepth;
+    std::size_t transactionRecords; // правок в открытой транзакции
+    SpatialIndexType indexType;     // для слоев, создаваемых при свертке
+
+    // Состояние перед самой старой правкой журнала
+    std::vector<Layer> checkpointLayers;
+    bool hasCheckpoint;
+
+    void collapseOldestStep();
+
+public:
+    static const std::size_t DEFAULT_HISTORY_LIMIT = 1024;
+
+    explicit EditJournal(SpatialIndexType type = SpatialIndexType::GRID);
+
+    void record(EditRecord edit);
+    void beginTransaction();
+    bool commitTransaction();
+    bool inTransaction() const;
+
+    // Снимают шаг целиком: undo - правки в порядке отмены (с последней),
+    // redo - в порядке повторного применения
+    bool takeUndoStep(std::vector<EditRecord>& step);
+    bool takeRedoStep(std::vector<EditRecord>& step);
+    // Снимает правки открытой транзакции (без redo) и закрывает ее
+    void takeTransaction(std::vector<EditRecord>& step);
+
+    // Лимит шагов: старые шаги сворачиваются в точку отката, если она есть,
+    // иначе просто забываются
+    void setHistoryLimit(std::size_t steps);
+    std::size_t getHistoryLimit() const;
+    std::size_t getUndoSteps() const;
+    std::size_t getRedoSteps() const;
+    std::size_t getMemoryUsage() const; // записи и снимок (без общего содержимого слоев)
+
+    // Точка отката - копия слоев (общее содержимое, O(числа слоев));
+    // история до нее больше не нужна и очищается
+    void setCheckpoint(const std::vector<Layer*>& layers);
+    const std::vector<Layer>* getCheckpoint() const; // nullptr, если не задана
+    // Нужен ли elem (или его копия) для undo/redo или точки отката
+    bool referencesElement(const Element* elem) const;
+    void clear();
+};
+
+#endif // JOURNAL_H
@@ -1,96 +1,106 @@
 // layer.cpp
 #include "layer.h"
+#include "connectkernel.h"
+#include "diagnostics.h"
+#include "metrics.h"
 #include <iostream>
 #include <algorithm>
 #include <limits>
+#include <string>
+
+const int Layer::MIN_COORDINATE;
+const int Layer::MAX_COORDINATE;
+
+std::size_t LayerMemoryStats::total() const {
+    return placements + bounds + raster + index;
+}
+
+Layer::Data::Data(SpatialIndexType indexType, int blockSize)
+    : minX(0), minY(0), maxX(0), maxY(0), nextPlacementId(0), version(0),
+      spatialIndex(indexType, blockSize) {}
+
+Layer::Data& Layer::edit() {
+    if (data.use_count() > 1) {
+        data = std::make_shared<Data>(*data);
+    }
+    return *data;
+}
+
+void Layer::addBounds(const Shape& shape, int x, int y) {
+    Data& d = edit();
+    d.leftEdges.insert(x);
+    d.topEdges.insert(y);
+    d.rightEdges.insert(x + shape.getWidth() - 1);
+    d.bottomEdges.insert(y + shape.getHeight() - 1);
+}
+
+void Layer::removeBounds(const Shape& shape, int x, int y) {
+    Data& d = edit();
+    d.leftEdges.erase(d.leftEdges.find(x));
+    d.topEdges.erase(d.topEdges.find(y));
+    d.rightEdges.erase(d.rightEdges.find(x + shape.getWidth() - 1));
+    d.bottomEdges.erase(d.bottomEdges.find(y + shape.getHeight() - 1));
+}
 
 void Layer::updateBounds() {
-    if (elements.empty()) {
-        minX = minY = maxX = maxY = 0;
+    Data& d = edit();
+    if (d.elements.empty()) {
+        d.minX = d.minY = d.maxX = d.maxY = 0;
         return;
     }
+    d.minX = *d.leftEdges.begin();
+    d.minY = *d.topEdges.begin();
+    d.maxX = *d.rightEdges.rbegin();
+    d.maxY = *d.bottomEdges.rbegin();
+}
 
-    minX = std::numeric_limits<int>::max();
-    minY = std::numeric_limits<int>::max();
-    maxX = std::numeric_limits<int>::min();
-    maxY = std::numeric_limits<int>::min();
-
-    for (const auto& elemPair : elements) {
-        Element* elem = elemPair.first;
-        int x = elemPair.second.first;
-        int y = elemPair.second.second;
-        int elemWidth = elem->getWidth();
-        int elemHeight = elem->getHeight();
-
-        minX = std::min(minX, x);
-        minY = std::min(minY, y);
-        maxX = std::max(maxX, x + elemWidth - 1);
-        maxY = std::max(maxY, y + elemHeight - 1);
-    }
-}
-
-void Layer::updateGrid() {
-    for (auto& row : grid) {
-        std::fill(row.begin(), row.end(), ' ');
-    }
-
-    for (const auto& elemPair : elements) {
-        Element* elem = elemPair.first;
-        int startX = elemPair.second.first;
-        int startY = elemPair.second.second;
-
-        for (int i = 0; i < elem->getHeight(); i++) {
-            for (int j = 0; j < elem->getWidth(); j++) {
-                char cell = elem->getCell(j, i);
-                if (cell != ' ') {
-                    if (startY + i >= grid.size()) {
-                        grid.resize(startY + i + 1, std::vector<char>(grid.empty() ? 0 : grid[0].size(), ' '));
-                    }
-                    if (startX + j >= grid[0].size()) {
-                        for (auto& row : grid) {
-                            row.resize(startX + j + 1, ' ');
-                        }
-                    }
-                    grid[startY + i][startX + j] = cell;
-                }
-            }
-        }
-    }
+Layer::Layer() : data(std::make_shared<Data>(SpatialIndexType::GRID, SpatialIndex::DEFAULT_BLOCK_SIZE)) {}
+
+Layer::Layer(SpatialIndexType indexType, int blockSize)
+    : data(std::make_shared<Data>(indexType, blockSize)) {}
+
+Layer::Layer(const Layer& other) : data(other.data) {}
+
+Layer& Layer::operator=(const Layer& other) {
+    data = other.data;
+    return *this;
 }
 
-Layer::Layer() : minX(0), minY(0), maxX(0), maxY(0) {}
+Layer::~Layer() {}
 
-Layer::Layer(const Layer& other) {
-    minX = other.minX;
-    minY = other.minY;
-    maxX = other.maxX;
-    maxY = other.maxY;
-    elements = other.elements;
+bool Layer::sharesDataWith(const Layer& other) const {
+    return data == other.data;
 }
 
-Layer::~Layer() {
-    elements.clear();
+bool Layer::fitsCoordinates(int x, int y, int width, int height) {
+    long long lastX = static_cast<long long>(x) + std::max(width, 1) - 1;
+    long long lastY = static_cast<long long>(y) + std::max(height, 1) - 1;
+    return x >= MIN_COORDINATE && y >= MIN_COORDINATE &&
+           lastX <= MAX_COORDINATE && lastY <= MAX_COORDINATE;
 }
 
 bool Layer::hasOverlap(Element* elem, int x, int y) const {
-    int elemWidth = elem->getWidth();
-    int elemHeight = elem->getHeight();
-
-    for (const auto& existingPair : elements) {
-        Element* existingElem = existingPair.first;
-        int existingX = existingPair.second.first;
-        int existingY = existingPair.second.second;
-        int existingWidth = existingElem->getWidth();
-        int existingHeight = existingElem->getHeight();
-
-        if (x < existingX + existingWidth &&
-            x + elemWidth > existingX &&
-            y < existingY + existingHeight &&
-            y + elemHeight > existingY) {
-            return true;
-        }
+    METRIC_ADD(OVERLAP_CALLS, 1);
+    if (!fitsCoordinates(x, y, elem->getWidth(), elem->getHeight())) {
+        return true;
     }
-    return false;
+    return data->spatialIndex.intersectsAny(x, y, elem->getWidth(), elem->getHeight());
+}
+
+bool Layer::hasOverlap(Element* elem, Orientation o, int x, int y) const {
+    return elem && hasOverlap(elem->getOriented(o), x, y);
+}
+
+void Layer::insertPlacement(Element* elem, int x, int y) {
+    Data& d = edit();
+    d.elements.push_back(std::make_pair(elem, std::make_pair(x, y)));
+    d.placementIds.push_back(d.nextPlacementId);
+    d.shapes.push_back(elem->getShapePtr());
+    d.spatialIndex.insert(IndexEntry{elem, d.nextPlacementId, x, y, elem->getWidth(), elem->getHeight(),
+                                     &elem->getShape()});
+    d.raster.paint(d.nextPlacementId, *d.shapes.back(), x, y);
+    d.nextPlacementId++;
+    addBounds(*d.shapes.back(), x, y);
 }
 
 bool Layer::placeElement(Element* elem, int x, int y) {
@@ -100,130 +110,536 @@ bool Layer::placeElement(Element* elem, int x, int y) {
         return false;
     }
 
-    elements.push_back(std::make_pair(elem, std::make_pair(x, y)));
-
+    insertPlacement(elem, x, y);
     updateBounds();
+    data->version++;
+
+    return true;
+}
+
+bool Layer::placeElement(Element* elem, Orientation o, int x, int y) {
+    return elem && placeElement(elem->getOriented(o), x, y);
+}
+
+int Layer::placeElements(const std::vector<std::pair<Element*, std::pair<int, int>>>& items,
+                         std::vector<PlacementStatus>& statuses) {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < items.size(); i++) {
+        if (statuses[i] == PlacementStatus::PLACED && items[i].first) {
+            order.push_back(i);
+        }
+    }
+    // Обход по строкам, затем по столбцам - соседние элементы идут подряд
+    std::sort(order.begin(), order.end(), [&items](size_t a, size_t b) {
+        return items[a].second.second != items[b].second.second
+            ? items[a].second.second < items[b].second.second
+            : items[a].second.first < items[b].second.first;
+    });
+
+    SpatialIndex batchIndex(SpatialIndexType::GRID, data->spatialIndex.getBlockSize());
+    for (size_t i : order) {
+        Element* elem = items[i].first;
+        int x = items[i].second.first;
+        int y = items[i].second.second;
+        if (!fitsCoordinates(x, y, elem->getWidth(), elem->getHeight())) {
+            statuses[i] = PlacementStatus::OUT_OF_RANGE;
+        } else if (hasOverlap(elem, x, y)) {
+            statuses[i] = PlacementStatus::OVERLAP_EXISTING;
+        } else if (batchIndex.intersectsAny(x, y, elem->getWidth(), elem->getHeight())) {
+            statuses[i] = PlacementStatus::OVERLAP_BATCH;
+        } else {
+            batchIndex.insert(IndexEntry{elem, static_cast<int>(i), x, y, elem->getWidth(), elem->getHeight(),
+                                             &elem->getShape()});
+        }
+    }
 
+    // Добавляем в исходном порядке пачки, границы и версию - один раз
+    int placedCount = 0;
+    for (size_t i = 0; i < items.size(); i++) {
+        if (statuses[i] == PlacementStatus::PLACED && items[i].first) {
+            insertPlacement(items[i].first, items[i].second.first, items[i].second.second);
+            placedCount++;
+        }
+    }
+    if (placedCount > 0) {
+        updateBounds();
+        data->version++;
+    }
+    return placedCount;
+}
+
+bool Layer::insertElement(int index, Element* elem, int x, int y) {
+    if (!elem || index < 0 || index > data->elements.size() || hasOverlap(elem, x, y)) {
+        return false;
+    }
+    insertPlacement(elem, x, y);
+    // Добавленный в конец элемент переносим на его место
+    Data& d = *data;
+    std::rotate(d.elements.begin() + index, d.elements.end() - 1, d.elements.end());
+    std::rotate(d.placementIds.begin() + index, d.placementIds.end() - 1, d.placementIds.end());
+    std::rotate(d.shapes.begin() + index, d.shapes.end() - 1, d.shapes.end());
+    updateBounds();
+    d.version++;
     return true;
 }
 
 void Layer::removeElement(int index) {
-    if (index >= 0 && index < elements.size()) {
-        elements.erase(elements.begin() + index);
-        updateGrid();
+    if (index >= 0 && index < data->elements.size()) {
+        Data& d = edit();
+        const auto& removed = d.elements[index];
+        const Shape& shape = *d.shapes[index];
+        d.spatialIndex.remove(IndexEntry{removed.first, d.placementIds[index], removed.second.first,
+                                         removed.second.second, shape.getWidth(), shape.getHeight(), &shape});
+        d.raster.erase(shape, removed.second.first, removed.second.second);
+        removeBounds(shape, removed.second.first, removed.second.second);
+        d.elements.erase(d.elements.begin() + index);
+        d.placementIds.erase(d.placementIds.begin() + index);
+        d.shapes.erase(d.shapes.begin() + index);
+        updateBounds();
+        d.version++;
     }
 }
 
 void Layer::clearLayer() {
-    elements.clear();
-    updateGrid();
+    if (data.use_count() > 1) {
+        // Общее содержимое не копируем - сразу начинаем с пустого
+        std::shared_ptr<Data> empty = std::make_shared<Data>(data->spatialIndex.getType(),
+                                                             data->spatialIndex.getBlockSize());
+        empty->nextPlacementId = data->nextPlacementId;
+        empty->version = data->version + 1;
+        data = empty;
+        return;
+    }
+    Data& d = *data;
+    d.elements.clear();
+    d.placementIds.clear();
+    d.shapes.clear();
+    d.spatialIndex.clear();
+    d.raster.clear();
+    d.leftEdges.clear();
+    d.topEdges.clear();
+    d.rightEdges.clear();
+    d.bottomEdges.clear();
+    updateBounds();
+    d.version++;
 }
 
 int Layer::getWidth() const {
-    return elements.empty() ? 0 : (maxX - minX + 1);
+    return data->elements.empty() ? 0 : (data->maxX - data->minX + 1);
 }
 
 int Layer::getHeight() const {
-    return elements.empty() ? 0 : (maxY - minY + 1);
+    return data->elements.empty() ? 0 : (data->maxY - data->minY + 1);
 }
 
-int Layer::getMinX() const { return minX; }
-int Layer::getMinY() const { return minY; }
-int Layer::getMaxX() const { return maxX; }
-int Layer::getMaxY() const { return maxY; }
+int Layer::getMinX() const { return data->minX; }
+int Layer::getMinY() const { return data->minY; }
+int Layer::getMaxX() const { return data->maxX; }
+int Layer::getMaxY() const { return data->maxY; }
 
 const std::vector<std::pair<Element*, std::pair<int, int>>>& Layer::getElements() const {
-    return elements;
+    return data->elements;
 }
 
-char Layer::getCell(int x, int y) const {
-    for (const auto& elemPair : elements) {
-        Element* elem = elemPair.first;
-        int elemX = elemPair.second.first;
-        int elemY = elemPair.second.second;
-        int elemWidth = elem->getWidth();
-        int elemHeight = elem->getHeight();
-
-        if (x >= elemX && x < elemX + elemWidth &&
-            y >= elemY && y < elemY + elemHeight) {
-            return elem->getCell(x - elemX, y - elemY);
+bool Layer::containsElement(const Element* elem) const {
+    for (const auto& placed : data->elements) {
+        if (elem->isSameOrVariant(placed.first)) {
+            return true;
         }
     }
-    return ' ';
+    return false;
+}
+
+char Layer::getCell(int x, int y) const {
+    METRIC_ADD(GET_CELL_CALLS, 1);
+    return data->raster.getCell(x, y);
+}
+
+int Layer::getOwnerAt(int x, int y) const {
+    return data->raster.getOwner(x, y);
+}
+
+int Layer::getPlacementId(int index) const {
+    if (index < 0 || index >= data->placementIds.size()) {
+        return LayerRaster::NO_OWNER;
+    }
+    return data->placementIds[index];
+}
+
+const Shape& Layer::getPlacedShape(int index) const {
+    return *data->shapes[index];
+}
+
+int Layer::findPlacementIndex(int placementId) const {
+    const std::vector<int>& ids = data->placementIds;
+    auto it = std::find(ids.begin(), ids.end(), placementId);
+    return (it == ids.end()) ? -1 : static_cast<int>(it - ids.begin());
+}
+
+void Layer::findElementsIn(const Rect& region, std::vector<IndexEntry>& out) const {
+    data->spatialIndex.query(region.x, region.y, region.width, region.height, out);
+}
+
+unsigned long Layer::getVersion() const {
+    return data->version;
+}
+
+const LayerRaster& Layer::getRaster() const {
+    return data->raster;
+}
+
+SpatialIndexType Layer::getIndexType() const {
+    return data->spatialIndex.getType();
+}
+
+LayerMemoryStats Layer::getMemoryStats() const {
+    LayerMemoryStats stats;
+    stats.placements = sizeof(Data) +
+        data->elements.capacity() * sizeof(data->elements[0]) +
+        data->placementIds.capacity() * sizeof(int) +
+        data->shapes.capacity() * sizeof(data->shapes[0]);
+    // Узел дерева: значение, три указателя и цвет
+    const std::size_t treeNode = sizeof(int) + 4 * sizeof(void*);
+    stats.bounds = (data->leftEdges.size() + data->topEdges.size() +
+                    data->rightEdges.size() + data->bottomEdges.size()) * treeNode;
+    stats.raster = data->raster.getMemoryUsage();
+    stats.index = data->spatialIndex.getMemoryUsage();
+    stats.shared = data.use_count() > 1;
+    return stats;
 }
 
 bool Layer::isEmpty() const {
-    return elements.empty();
+    return data->elements.empty();
+}
+
+void Layer::getSocketWindow(int x, int y, int width, int height, std::vector<std::uint64_t>& out) const {
+    data->raster.getSocketWindow(x, y, width, height, out);
+}
+
+ConnectionCheck Layer::checkLowerConnection(Element* elem, int x, int y, const Layer* lowerLayer) const {
+    if (!elem) return ConnectionCheck{false, x, y};
+    return checkLowerConnection(elem->getShape(), x, y, lowerLayer);
+}
+
+ConnectionCheck Layer::checkLowerConnection(const Shape& shape, int x, int y, const Layer* lowerLayer) const {
+    ConnectionCheck result = {false, x, y};
+    if (!lowerLayer || !fitsCoordinates(x, y, shape.getWidth(), shape.getHeight())) return result;
+    METRIC_ADD(CONNECTION_CHECKS, 1);
+    METRIC_ADD(CELLS_COMPARED, static_cast<std::uint64_t>(shape.getWidth()) * shape.getHeight());
+
+    // Соединители элемента и гнезда нижнего слоя под ним лежат в буферах
+    // одинаковой формы, поэтому проверка - одно векторное сравнение
+    const BitPlane& connectors = shape.getConnectors();
+    std::vector<std::uint64_t> sockets;
+    lowerLayer->getSocketWindow(x, y, shape.getWidth(), shape.getHeight(), sockets);
+
+    long failWord = findConnectionViolation(connectors.getData(),
+                                            sockets.data(), sockets.size());
+    if (failWord < 0) {
+        result.connected = true;
+        return result;
+    }
+
+    int rowWords = connectors.getWordsPerRow();
+    std::uint64_t missing = connectors.getData()[failWord] & ~sockets[failWord];
+    result.failY = y + static_cast<int>(failWord / rowWords);
+    result.failX = x + static_cast<int>(failWord % rowWords) * BitPlane::WORD_BITS
+                   + __builtin_ctzll(missing);
+    return result;
 }
 
 bool Layer::canPlaceWithLowerLayer(Element* elem, int x, int y, const Layer* lowerLayer) const {
     if (!elem || !lowerLayer) return false;
 
-    int elemWidth = elem->getWidth();
-    int elemHeight = elem->getHeight();
+    ConnectionCheck check = checkLowerConnection(elem, x, y, lowerLayer);
+    if (!check.connected) {
+        reportDiagnostic(DiagnosticCode::NO_CONNECTION, -1, -1, check.failX, check.failY, 0, elem);
+        return false;
+    }
+    return true;
+}
+
+// Устанавливает биты [from, to) упакованной строки
+static void fillBits(std::uint64_t* row, int from, int to) {
+    for (int bit = from; bit < to; ) {
+        int offset = bit % BitPlane::WORD_BITS;
+        int count = std::min(to - bit, BitPlane::WORD_BITS - offset);
+        std::uint64_t mask = (count == BitPlane::WORD_BITS) ? ~0ULL : (((1ULL << count) - 1) << offset);
+        row[bit / BitPlane::WORD_BITS] |= mask;
+        bit += count;
+    }
+}
+
+void Layer::findFreeCorners(Element* elem, const Rect& band, const Layer* lowerLayer,
+                            const std::vector<std::vector<int>>& connectorColumns,
+                            std::vector<std::uint64_t>& valid) const {
+    int w = std::max(elem->getWidth(), 1);
+    int h = std::max(elem->getHeight(), 1);
+
+    // Окно - все клетки, которые может накрыть элемент с углом в band
+    int windowWidth = band.width + w - 1;
+    int windowHeight = band.height + h - 1;
+    BitPlane freeCells(windowWidth, windowHeight);
+    std::vector<IndexEntry> nearby;
+    data->spatialIndex.query(band.x, band.y, windowWidth, windowHeight, nearby);
+    for (const IndexEntry& entry : nearby) {
+        // Пересечение проверяется по прямоугольникам, как в hasOverlap
+        int left = std::max(entry.x, band.x) - band.x;
+        int right = std::min(entry.x + entry.width, band.x + windowWidth) - band.x;
+        int top = std::max(entry.y, band.y) - band.y;
+        int bottom = std::min(entry.y + entry.height, band.y + windowHeight) - band.y;
+        for (int row = top; row < bottom; row++) {
+            fillBits(freeCells.getRow(row), left, right);
+        }
+    }
+    int rowWords = freeCells.getWordsPerRow();
+    int tailBits = windowWidth % BitPlane::WORD_BITS;
+    for (int row = 0; row < windowHeight; row++) {
+        std::uint64_t* words = freeCells.getRow(row);
+        for (int k = 0; k < rowWords; k++) words[k] = ~words[k];
+        if (tailBits) words[rowWords - 1] &= (1ULL << tailBits) - 1;
+    }
+
+    // Сужение по горизонтали: бит x остается, если свободны x..x+w-1.
+    // Удвоение шага - log2(w) проходов; слова идут по возрастанию,
+    // поэтому следующее слово еще не изменено, когда его читают
+    for (int covered = 1; covered < w; ) {
+        int step = std::min(covered, w - covered);
+        for (int row = 0; row < windowHeight; row++) {
+            std::uint64_t* words = freeCells.getRow(row);
+            for (int k = 0; k < rowWords; k++) {
+                words[k] &= freeCells.extractBits(k * BitPlane::WORD_BITS + step, row);
+            }
+        }
+        covered += step;
+    }
 
-    for (int i = 0; i < elemHeight; i++) {
-        for (int j = 0; j < elemWidth; j++) {
-            char elemCell = elem->getCell(j, i);
+    // Гнезда нижнего слоя под окном
+    BitPlane sockets;
+    std::vector<std::uint64_t> socketWords;
+    if (lowerLayer) {
+        lowerLayer->getSocketWindow(band.x, band.y, windowWidth, windowHeight, socketWords);
+        sockets = BitPlane::view(windowWidth, windowHeight, socketWords.data());
+    }
 
-            if (elemCell == '1') {
-                char lowerCell = lowerLayer->getCell(x + j, y + i);
-                if (lowerCell != '0') {
-                    std::cout << "Connection issue at (" << x + j << "," << y + i << "," << lowerLayer->getCell(1, 0) << ")" << std::endl;
-                    return false;
+    int candidateWords = (band.width + BitPlane::WORD_BITS - 1) / BitPlane::WORD_BITS;
+    int candidateTail = band.width % BitPlane::WORD_BITS;
+    valid.assign(static_cast<std::size_t>(candidateWords) * band.height, 0);
+    for (int y = 0; y < band.height; y++) {
+        std::uint64_t* rowValid = valid.data() + static_cast<std::size_t>(y) * candidateWords;
+        for (int k = 0; k < candidateWords; k++) {
+            std::uint64_t bits = ~0ULL;
+            for (int dy = 0; dy < h && bits; dy++) {
+                bits &= freeCells.getRow(y + dy)[k];
+            }
+            for (int cy = 0; cy < h && bits && lowerLayer; cy++) {
+                for (int cx : connectorColumns[cy]) {
+                    bits &= sockets.extractBits(k * BitPlane::WORD_BITS + cx, y + cy);
                 }
             }
+            rowValid[k] = bits;
         }
+        if (candidateTail) rowValid[candidateWords - 1] &= (1ULL << candidateTail) - 1;
     }
-    return true;
 }
 
-void Layer::display() const {
-    if (elements.empty()) {
-        std::cout << "Layer is empty" << std::endl << std::endl;
-        return;
+void Layer::findPlacements(Element* elem, const Rect& requested, const Layer* lowerLayer,
+                           std::vector<std::pair<int, int>>& out, std::size_t limit) const {
+    if (!elem || requested.width <= 0 || requested.height <= 0) return;
+    int w = std::max(elem->getWidth(), 1);
+    int h = std::max(elem->getHeight(), 1);
+
+    // Только углы, при которых элемент целиком в допустимых координатах
+    long long firstX = std::max<long long>(requested.x, MIN_COORDINATE);
+    long long firstY = std::max<long long>(requested.y, MIN_COORDINATE);
+    long long lastX = std::min<long long>(static_cast<long long>(requested.x) + requested.width - 1,
+                                          static_cast<long long>(MAX_COORDINATE) - w + 1);
+    long long lastY = std::min<long long>(static_cast<long long>(requested.y) + requested.height - 1,
+                                          static_cast<long long>(MAX_COORDINATE) - h + 1);
+
+    // Соединители элемента по строкам
+    std::vector<std::vector<int>> connectorColumns(h);
+    bool needSockets = false;
+    if (lowerLayer) {
+        const BitPlane& connectors = elem->getConnectors();
+        for (int cy = 0; cy < connectors.getHeight(); cy++) {
+            const std::uint64_t* row = connectors.getRow(cy);
+            for (int k = 0; k < connectors.getWordsPerRow(); k++) {
+                for (std::uint64_t bits = row[k]; bits; bits &= bits - 1) {
+                    connectorColumns[cy].push_back(k * BitPlane::WORD_BITS + __builtin_ctzll(bits));
+                    needSockets = true;
+                }
+            }
+        }
+    }
+
+    // Углы, где элемент может задеть слой, проверяются по растру; остальные
+    // заведомо свободны. Если соединителям нужны гнезда, вне нижнего слоя
+    // мест заведомо нет, а внутри проверяется каждый угол
+    long long innerX0, innerX1, innerY0, innerY1;
+    if (needSockets) {
+        if (lowerLayer->isEmpty()) return;
+        firstX = std::max<long long>(firstX, static_cast<long long>(lowerLayer->getMinX()) - w + 1);
+        firstY = std::max<long long>(firstY, static_cast<long long>(lowerLayer->getMinY()) - h + 1);
+        lastX = std::min<long long>(lastX, lowerLayer->getMaxX());
+        lastY = std::min<long long>(lastY, lowerLayer->getMaxY());
+        innerX0 = firstX;
+        innerX1 = lastX;
+        innerY0 = firstY;
+        innerY1 = lastY;
+    } else if (isEmpty()) {
+        innerX0 = innerY0 = 0;
+        innerX1 = innerY1 = -1;
+    } else {
+        innerX0 = std::max<long long>(firstX, static_cast<long long>(data->minX) - w + 1);
+        innerY0 = std::max<long long>(firstY, static_cast<long long>(data->minY) - h + 1);
+        innerX1 = std::min<long long>(lastX, data->maxX);
+        innerY1 = std::min<long long>(lastY, data->maxY);
     }
-    int width = getWidth();
-    int height = getHeight();
-    std::cout << "Layer (" << width << "x" << height << "):" << std::endl;
-    std::cout << "Bounds: X[" << minX << ".." << maxX << "] Y[" << minY << ".." << maxY << "]" << std::endl;
-
-    std::cout << "I";
-    for (int x = 0; x < width; x++) std::cout << "__";
-    std::cout << "I" << std::endl;
-
-    for (int y = 0; y < height; y++) {
-        std::cout << "|";
-        for (int x = minX; x <= maxX; x++) {
-            char cell = getCell(x, y);
-            switch (cell) {
-                case ' ': std::cout << "  "; break;
-                case '0': std::cout << "0 "; break;
-                case '1': std::cout << "1 "; break;
-                default: std::cout << "? "; break;
+    if (firstX > lastX || firstY > lastY) return;
+    bool hasInner = innerX0 <= innerX1 && innerY0 <= innerY1;
+
+    // Заведомо свободные углы строки y от from до to
+    auto emitFree = [&out, limit](long long y, long long from, long long to) {
+        for (long long x = from; x <= to; x++) {
+            out.push_back(std::make_pair(static_cast<int>(x), static_cast<int>(y)));
+            if (limit > 0 && out.size() >= limit) return false;
+        }
+        return true;
+    };
+
+    // Проверяемая часть обходится полосами строк, чтобы окно полосы
+    // занимало не больше BAND_CELLS бит независимо от размера region
+    const long long BAND_CELLS = 1 << 22;
+    int innerWidth = hasInner ? static_cast<int>(innerX1 - innerX0 + 1) : 0;
+    long long bandRows = hasInner ? std::max(1LL, BAND_CELLS / (static_cast<long long>(innerWidth) + w - 1)) : 0;
+    int candidateWords = (innerWidth + BitPlane::WORD_BITS - 1) / BitPlane::WORD_BITS;
+    std::vector<std::uint64_t> valid;
+    for (long long y = firstY; y <= lastY; ) {
+        if (!hasInner || y < innerY0 || y > innerY1) {
+            if (!emitFree(y, firstX, lastX)) return;
+            y++;
+            continue;
+        }
+        int rows = static_cast<int>(std::min(bandRows, innerY1 - y + 1));
+        findFreeCorners(elem, Rect{static_cast<int>(innerX0), static_cast<int>(y), innerWidth, rows},
+                        needSockets ? lowerLayer : nullptr, connectorColumns, valid);
+        for (int r = 0; r < rows; r++) {
+            long long rowY = y + r;
+            if (!emitFree(rowY, firstX, innerX0 - 1)) return;
+            const std::uint64_t* rowValid = valid.data() + static_cast<std::size_t>(r) * candidateWords;
+            for (int k = 0; k < candidateWords; k++) {
+                for (std::uint64_t bits = rowValid[k]; bits; bits &= bits - 1) {
+                    out.push_back(std::make_pair(static_cast<int>(innerX0) + k * BitPlane::WORD_BITS +
+                                                 __builtin_ctzll(bits), static_cast<int>(rowY)));
+                    if (limit > 0 && out.size() >= limit) return;
+                }
             }
+            if (!emitFree(rowY, innerX1 + 1, lastX)) return;
         }
-        std::cout << "|" << std::endl;
+        y += rows;
     }
+}
 
-    std::cout << "I";
-    for (int x = 0; x < width; x++) std::cout << "__";
-    std::cout << "I" << std::endl;
+bool Layer::canPlaceWithLowerLayer(Element* elem, Orientation o, int x, int y, const Layer* lowerLayer) const {
+    return elem && canPlaceWithLowerLayer(elem->getOriented(o), x, y, lowerLayer);
+}
+
+// Есть ли установленный бит в отрезке [from, to) упакованной строки
+static bool anyBits(const std::vector<std::uint64_t>& row, int from, int to) {
+    for (int bit = from; bit < to; ) {
+        int word = bit / BitPlane::WORD_BITS;
+        int offset = bit % BitPlane::WORD_BITS;
+        int count = std::min(to - bit, BitPlane::WORD_BITS - offset);
+        std::uint64_t mask = (count == BitPlane::WORD_BITS) ? ~0ULL : (((1ULL << count) - 1) << offset);
+        if (row[word] & mask) return true;
+        bit += count;
+    }
+    return false;
+}
 
-    std::cout << "Elements: " << elements.size() << std::endl;
-    for (size_t i = 0; i < elements.size(); i++) {
-        Element* elem = elements[i].first;
-        int x = elements[i].second.first;
-        int y = elements[i].second.second;
+void Layer::render(std::string& out, const Rect& viewport, int scale) const {
+    if (data->elements.empty()) {
+        out += "Layer is empty\n\n";
+        return;
+    }
+    scale = std::max(scale, 1);
+    int columns = (std::max(viewport.width, 0) + scale - 1) / scale;
+    int rows = (std::max(viewport.height, 0) + scale - 1) / scale;
+
+    out += "Layer (" + std::to_string(getWidth()) + "x" + std::to_string(getHeight()) + "):\n";
+    out += "Bounds: X[" + std::to_string(data->minX) + ".." + std::to_string(data->maxX) +
+           "] Y[" + std::to_string(data->minY) + ".." + std::to_string(data->maxY) + "]\n";
+    if (scale > 1 || viewport.x != data->minX || viewport.y != data->minY ||
+        viewport.width != getWidth() || viewport.height != getHeight()) {
+        out += "View: X[" + std::to_string(viewport.x) + ".." + std::to_string(viewport.x + viewport.width - 1) +
+               "] Y[" + std::to_string(viewport.y) + ".." + std::to_string(viewport.y + viewport.height - 1) +
+               "], scale 1:" + std::to_string(scale) + "\n";
+    }
 
-        std::cout << "  " << i + 1 << ". ";
-        if (elem->getType() == ElementType::MOTOR) {
-            std::cout << "Motor ";
-        } else {
-            std::cout << "Element ";
+    std::string border = "I" + std::string(2 * columns, '_') + "I\n";
+    out += border;
+    out.reserve(out.size() + (2 * columns + 2) * rows + border.size());
+
+    // Строка вывода: OR по scale строкам растра, затем блоки по scale бит
+    int words = (viewport.width + BitPlane::WORD_BITS - 1) / BitPlane::WORD_BITS;
+    std::vector<std::uint64_t> occupied(std::max(words, 0));
+    std::vector<std::uint64_t> connected(std::max(words, 0));
+    for (int r = 0; r < rows; r++) {
+        std::fill(occupied.begin(), occupied.end(), 0);
+        std::fill(connected.begin(), connected.end(), 0);
+        int firstY = viewport.y + r * scale;
+        int lastY = std::min(firstY + scale, viewport.y + viewport.height);
+        for (int y = firstY; y < lastY; y++) {
+            for (int k = 0; k < words; k++) {
+                std::uint64_t occ, conn;
+                data->raster.getRowBits(viewport.x + k * BitPlane::WORD_BITS, y, occ, conn);
+                occupied[k] |= occ;
+                connected[k] |= conn;
+            }
+        }
+        out += '|';
+        for (int c = 0; c < columns; c++) {
+            int from = c * scale;
+            int to = std::min(from + scale, viewport.width);
+            if (anyBits(connected, from, to)) {
+                out += "1 ";
+            } else if (anyBits(occupied, from, to)) {
+                out += "0 ";
+            } else {
+                out += "  ";
+            }
         }
-        std::cout << "at (" << x << "," << y << ") size: "
-                  << elem->getWidth() << "x" << elem->getHeight() << std::endl;
+        out += "|\n";
     }
-    std::cout << std::endl;
+    out += border;
+
+    out += "Elements: " + std::to_string(data->elements.size()) + "\n";
+    for (size_t i = 0; i < data->elements.size(); i++) {
+        Element* elem = data->elements[i].first;
+        const Shape& shape = *data->shapes[i]; // размер на слое, а не текущий
+        out += "  " + std::to_string(i + 1) + ". ";
+        out += elem->getType() == ElementType::MOTOR ? "Motor " : "Element ";
+        out += "at (" + std::to_string(data->elements[i].second.first) + "," +
+               std::to_string(data->elements[i].second.second) + ") size: " +
+               std::to_string(shape.getWidth()) + "x" + std::to_string(shape.getHeight()) + "\n";
+    }
+    out += "\n";
+}
+
+void Layer::display() const {
+    display(Rect{data->minX, data->minY, getWidth(), getHeight()}, 1);
+}
+
+void Layer::display(const Rect& viewport, int scale) const {
+    std::string out;
+    render(out, viewport, scale);
+    std::cout.write(out.data(), out.size());
+    std::cout.flush();
+}
+
+int Layer::getOverviewScale(int maxCells) const {
+    int side = std::max(getWidth(), getHeight());
+    maxCells = std::max(maxCells, 1);
+    return std::max(1, (side + maxCells - 1) / maxCells);
 }
@@ -3,25 +3,119 @@
 #define LAYER_H
 
 #include "element.h"
+#include "raster.h"
+#include "spatialindex.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <string>
 #include <vector>
 #include <utility>
 
+// Прямоугольная область слоя
+struct Rect {
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+// Результат проверки соединения с нижним слоем
+struct ConnectionCheck {
+    bool connected;
+    int failX; // первая клетка-соединитель без гнезда под ней
+    int failY;
+};
+
+// Память слоя по структурам, в байтах
+struct LayerMemoryStats {
+    std::size_t placements; // список размещений и их id
+    std::size_t bounds;     // множества краев элементов
+    std::size_t raster;
+    std::size_t index;
+    bool shared;            // содержимое общее с копией слоя (посчитано у обоих)
+
+    std::size_t total() const;
+};
+
+// Результат размещения одного элемента из пачки
+enum class PlacementStatus
+{
+    PLACED,
+    INVALID_LAYER,
+    INVALID_ELEMENT,
+    OVERLAP_EXISTING, // пересекает элемент, уже стоящий на слое
+    OVERLAP_BATCH,    // пересекает другой элемент той же пачки
+    NO_CONNECTION,    // соединители не стоят на гнездах нижнего слоя
+    ROLLED_BACK,      // подходил, но пачка отменена целиком
+    OUT_OF_RANGE,     // клетки элемента вне Layer::MIN_COORDINATE..MAX_COORDINATE
+};
+
 class Layer {
 private:
-    int minX, minY, maxX, maxY;
-    std::vector<std::vector<char>> grid;
-    std::vector<std::pair<Element*, std::pair<int, int>>> elements;
+    // Содержимое слоя. Копии слоя разделяют его, пока одна из них
+    // не начнет меняться (копирование при записи)
+    struct Data {
+        int minX, minY, maxX, maxY;
+        // Края всех элементов по осям: границы слоя - крайние значения
+        std::multiset<int> leftEdges, topEdges, rightEdges, bottomEdges;
+        std::vector<std::pair<Element*, std::pair<int, int>>> elements;
+        std::vector<int> placementIds; // id размещения для каждого элемента
+        // Форма каждого элемента на момент размещения: элемент можно изменить,
+        // а края, индекс и растр снимаются по тому, что было закрашено
+        std::vector<std::shared_ptr<const Shape>> shapes;
+        int nextPlacementId;
+        unsigned long version; // растет при каждом изменении слоя
+        SpatialIndex spatialIndex;
+        LayerRaster raster;
+
+        Data(SpatialIndexType indexType, int blockSize);
+    };
 
+    std::shared_ptr<Data> data;
+
+    Data& edit(); // отделяет собственную копию, если содержимое общее
+    void insertPlacement(Element* elem, int x, int y);
+    void addBounds(const Shape& shape, int x, int y);
+    void removeBounds(const Shape& shape, int x, int y);
     void updateBounds();
-    void updateGrid();
+    // Биты допустимых углов band, упакованные по строкам band;
+    // connectorColumns - столбцы соединителей elem в каждой его строке
+    void findFreeCorners(Element* elem, const Rect& band, const Layer* lowerLayer,
+                         const std::vector<std::vector<int>>& connectorColumns,
+                         std::vector<std::uint64_t>& valid) const;
 
 public:
+    // Допустимые координаты клеток: края и размеры слоя, а также суммы
+    // вида x + width в проверках помещаются в int
+    static const int MAX_COORDINATE = (1 << 30) - 1;
+    static const int MIN_COORDINATE = -MAX_COORDINATE;
+    // Лежат ли все клетки прямоугольника в допустимых координатах
+    static bool fitsCoordinates(int x, int y, int width, int height);
+
     Layer();
-    Layer(const Layer& other);
+    explicit Layer(SpatialIndexType indexType, int blockSize = SpatialIndex::DEFAULT_BLOCK_SIZE);
+    Layer(const Layer& other); // O(1): содержимое общее до первого изменения
+    Layer& operator=(const Layer& other);
     ~Layer();
 
+    bool sharesDataWith(const Layer& other) const;
+
+    // Вне допустимых координат место считается занятым
     bool hasOverlap(Element* elem, int x, int y) const;
     bool placeElement(Element* elem, int x, int y);
+    // То же для элемента в ориентации o (на слой попадает elem->getOriented(o))
+    bool hasOverlap(Element* elem, Orientation o, int x, int y) const;
+    bool placeElement(Element* elem, Orientation o, int x, int y);
+    // Размещает пачку за один проход: элементы с statuses[i] == PLACED
+    // проверяются на пересечения (в пространственном порядке) и добавляются,
+    // для остальных statuses[i] становится OVERLAP_* или OUT_OF_RANGE.
+    // Возвращает число добавленных.
+    int placeElements(const std::vector<std::pair<Element*, std::pair<int, int>>>& items,
+                      std::vector<PlacementStatus>& statuses);
+    // Вставка на позицию index списка элементов (для отмены удаления)
+    bool insertElement(int index, Element* elem, int x, int y);
     void removeElement(int index);
     void clearLayer();
 
@@ -32,10 +126,39 @@ public:
     int getMaxX() const;
     int getMaxY() const;
     const std::vector<std::pair<Element*, std::pair<int, int>>>& getElements() const;
+    // Стоит ли на слое elem или его повернутая копия
+    bool containsElement(const Element* elem) const;
     char getCell(int x, int y) const;
+    int getOwnerAt(int x, int y) const; // id размещения или LayerRaster::NO_OWNER
+    int getPlacementId(int index) const;
+    // Форма, с которой элемент index был размещен (сам элемент мог измениться)
+    const Shape& getPlacedShape(int index) const;
+    int findPlacementIndex(int placementId) const; // -1, если нет
+    void findElementsIn(const Rect& region, std::vector<IndexEntry>& out) const;
+    unsigned long getVersion() const;
+    const LayerRaster& getRaster() const;
+    SpatialIndexType getIndexType() const;
     bool isEmpty() const;
+    LayerMemoryStats getMemoryStats() const;
     bool canPlaceWithLowerLayer(Element* elem, int x, int y, const Layer* lowerLayer) const;
+    bool canPlaceWithLowerLayer(Element* elem, Orientation o, int x, int y, const Layer* lowerLayer) const;
+    ConnectionCheck checkLowerConnection(Element* elem, int x, int y, const Layer* lowerLayer) const;
+    // То же для формы: размещенные элементы проверяются по getPlacedShape
+    ConnectionCheck checkLowerConnection(const Shape& shape, int x, int y, const Layer* lowerLayer) const;
+    // Гнезда ('0') окна width x height с углом (x, y), упакованные по строкам
+    void getSocketWindow(int x, int y, int width, int height, std::vector<std::uint64_t>& out) const;
+    // Все углы (x, y) из region, где elem не пересекает элементы слоя и, если
+    // lowerLayer задан, все его соединители стоят на гнездах lowerLayer.
+    // Результат дописывается в out по строкам; limit > 0 - не больше limit позиций
+    void findPlacements(Element* elem, const Rect& region, const Layer* lowerLayer,
+                        std::vector<std::pair<int, int>>& out, std::size_t limit = 0) const;
+    // Дописывает в out кадр слоя: область viewport, каждая клетка вывода -
+    // блок scale x scale ('1', если в блоке есть соединитель, '0' - гнездо)
+    void render(std::string& out, const Rect& viewport, int scale = 1) const;
     void display() const;
+    void display(const Rect& viewport, int scale = 1) const;
+    // Масштаб, при котором слой умещается в maxCells клеток по каждой оси
+    int getOverviewScale(int maxCells) const;
 };
 
 #endif // LAYER_H
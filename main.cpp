@@ -1,13 +1,74 @@
 #include "element.h"
 #include "layer.h"
 #include "scheme.h"
+#include "connectkernel.h"
+#include "schemefile.h"
+#include "batch.h"
+#include "metrics.h"
+#include "simulation.h"
+#include "solver.h"
+#include "diagnostics.h"
 #include <iostream>
 #include <vector>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <limits>
 #include <sstream>
 using namespace std;
 
+// Печать диагностики ядра для пользователя консоли
+class ConsoleDiagnosticSink : public DiagnosticSink {
+public:
+    void report(const Diagnostic& d) override {
+        switch (d.code) {
+            case DiagnosticCode::LAYER_NOT_FOUND:
+                std::cout << "Error: Layer " << d.layerIndex << " doesn't exist!" << std::endl;
+                break;
+            case DiagnosticCode::ELEMENT_NOT_FOUND:
+                std::cout << "Error: Element " << d.elementIndex << " doesn't exist on layer " << d.layerIndex << "!" << std::endl;
+                break;
+            case DiagnosticCode::INVALID_ELEMENT:
+                std::cout << "Error: Invalid element!" << std::endl;
+                break;
+            case DiagnosticCode::OVERLAP:
+                std::cout << "Error: Element overlaps with existing elements on layer " << d.layerIndex << "!" << std::endl;
+                break;
+            case DiagnosticCode::OUT_OF_RANGE:
+                std::cout << "Error: Position (" << d.x << "," << d.y << ") is out of range!" << std::endl;
+                break;
+            case DiagnosticCode::NO_CONNECTION:
+                std::cout << "Error: Element doesn't properly connect with layer below! Connection issue at ("
+                          << d.x << "," << d.y << ")" << std::endl;
+                break;
+            case DiagnosticCode::BROKEN_CONNECTION:
+                std::cout << "Validation failed: Element " << d.elementIndex << " on layer " << d.layerIndex
+                          << " doesn't connect properly at (" << d.x << "," << d.y << ")!" << std::endl;
+                break;
+            case DiagnosticCode::LAYER_NOT_EMPTY:
+                std::cout << "Error: Cannot delete non-empty layer with layers above!" << std::endl;
+                break;
+            case DiagnosticCode::INVALID_MATRIX_CELL:
+                std::cout << "Error: Matrix can only contain '0' or '1'" << std::endl;
+                break;
+            case DiagnosticCode::EMPTY_MATRIX:
+                std::cout << "Empty matrix" << std::endl;
+                break;
+            case DiagnosticCode::INVALID_SPEED:
+                std::cout << "Error: Incorrect speed value!" << std::endl;
+                break;
+            case DiagnosticCode::INVALID_DIRECTION:
+                std::cout << "Error: Incorrect direction!" << std::endl;
+                break;
+            default:
+                std::cout << "Error: " << getDiagnosticName(d.code) << std::endl;
+        }
+    }
+};
+
 // Считыватель ввода элемента пользователем
 int getInput()
 {
@@ -81,6 +142,7 @@ void motorControlMenu(Motor *motor) {
         if (choice == 1)
         {
             motor->stop();
+            std::cout << "Motor has been stopped!" << std::endl;
             break;
         }
         else if (choice == 2)
@@ -92,6 +154,8 @@ void motorControlMenu(Motor *motor) {
             if ((0 < speed && speed <= 100) && (direction == 1 || direction == 2))
             {
                 motor->rotate(speed, direction);
+                std::cout << "Motor is moving with " << speed << " speed in "
+                          << (direction == 1 ? "clockwise" : "counterclockwise") << " direction" << std::endl;
                 break;
             }
             else
@@ -155,7 +219,7 @@ void motorControlMenu(Motor *motor) {
 
 }
 
-void makeElem(vector<Element *> &elements)
+void makeElem(vector<Element *> &elements, ElementStore &store)
 {
     cout << "MAKING ELEMENT" << endl;
     int width, height;
@@ -170,12 +234,12 @@ void makeElem(vector<Element *> &elements)
         }  
     }
     std::vector<std::vector<char>> matrix = inputMatrix(width, height);
-    Element *newElement = new Element(width, height, matrix);
+    Element *newElement = store.get(store.createElement(width, height, matrix));
     elements.push_back(newElement);
     std::cout << "Element is made!" << std::endl;
 }
 
-void makeMotor(vector<Element *> &elements)
+void makeMotor(vector<Element *> &elements, ElementStore &store)
 {
     cout << "MAKING MOTOR" << endl;
     int width, height;
@@ -223,7 +287,7 @@ void makeMotor(vector<Element *> &elements)
         }
     }
     std::vector<std::vector<char>> matrix = inputMatrix(width, height);
-    Motor *newMotor = new Motor(width, height, matrix, speed, direction);
+    Element *newMotor = store.get(store.createMotor(width, height, matrix, speed, direction));
     elements.push_back(newMotor);
     std::cout << "Motor is made!" << std::endl;
 }
@@ -265,6 +329,64 @@ void controlMotor(vector<Element*> &elements)
 }
 
 
+// Групповое управление всеми моторами хранилища
+void controlAllMotors(MotorRegistry &motors)
+{
+    while (true)
+    {
+        std::cout << "=== All Motors (" << motors.size() << ", running: " << motors.countRunning() << ") ===" << std::endl;
+        std::cout << "1. Stop all" << std::endl;
+        std::cout << "2. Scale speeds" << std::endl;
+        std::cout << "3. Set direction of running motors" << std::endl;
+        std::cout << "4. Back" << std::endl;
+        std::cout << "Choose action: ";
+
+        int choice = getInput();
+
+        if (choice == 1)
+        {
+            motors.stopAll();
+            std::cout << "All motors have been stopped!" << std::endl;
+        }
+        else if (choice == 2)
+        {
+            std::cout << "Enter speed percent (0-1000): ";
+            int percent = getInput();
+            if (percent >= 0 && percent <= 1000 && motors.scaleSpeeds(percent / 100.0f))
+            {
+                std::cout << "Speeds scaled by " << percent << "%" << std::endl;
+            }
+            else
+            {
+                std::cout << "Incorrect input" << std::endl;
+            }
+        }
+        else if (choice == 3)
+        {
+            std::cout << "Enter new direction (1-clockwise, 2-counterclockwise): ";
+            int newDirection = getInput();
+            if (newDirection == 1 || newDirection == 2)
+            {
+                std::size_t changed = motors.setDirectionWhere(
+                    [](int, int, bool running) { return running; }, newDirection);
+                std::cout << "Direction changed for " << changed << " motors" << std::endl;
+            }
+            else
+            {
+                std::cout << "Incorrect input" << std::endl;
+            }
+        }
+        else if (choice == 4)
+        {
+            return;
+        }
+        else
+        {
+            std::cout << "Incorrect choise, repeat: " << std::endl;
+        }
+    }
+}
+
 void showElements(vector<Element *> &elements)
 {
     if (elements.empty())
@@ -303,7 +425,8 @@ void showElements(vector<Element *> &elements)
 }
 
 void createNewScheme(Scheme& scheme) {
-    scheme = Scheme(); // Создаем новую схему
+    // Создаем новую схему, созданные элементы остаются в общем хранилище
+    scheme = Scheme(scheme.getElementStore());
     // Автоматически создаем базовый слой
     scheme.createLayer();
     std::cout << "New scheme created with base layer!" << std::endl;
@@ -426,6 +549,33 @@ void runTests()
     assert(refMat.size() == 3);
     assert(refMat[0].size() == 3);
 
+    // Упакованные строки: бит x строки y - клетка (x, y)
+    assert(elem2.getRowWords() == 1);
+    assert(elem2.getConnectorRow(1)[0] == 0x5);   // 1 0 1
+    assert(elem2.getOccupancyRow(1)[0] == 0x7);   // все три клетки заняты
+    assert(elem2.getConnectors().get(1, 0) == true);
+
+    // Широкий элемент занимает несколько слов на строку
+    Element wide(70, 1, std::vector<std::vector<char>>(1, std::vector<char>(70, '1')));
+    assert(wide.getRowWords() == 2);
+    assert(wide.getCell(69, 0) == '1');
+    assert(wide.getConnectorRow(0)[1] == 0x3F);
+
+    // Одинаковые матрицы хранятся одной формой
+    Element sameShape(3, 3, mat);
+    assert(sameShape.hasSameShape(elem3));
+    assert(sameShape.getShapeId() == elem3.getShapeId());
+    assert(&sameShape.getShape() == &elem3.getShape());
+    assert(!sameShape.hasSameShape(elem2)); // elem2 изменен через setCell
+    assert(sameShape.getSockets().get(0, 0) == true);
+    assert(sameShape.getSockets().get(1, 0) == false);
+    std::size_t shapeCount = ShapeRegistry::instance().getShapeCount();
+    {
+        Element copies[3] = {Element(3, 3, mat), Element(3, 3, mat), Element(3, 3, mat)};
+        assert(copies[2].hasSameShape(sameShape));
+        assert(ShapeRegistry::instance().getShapeCount() == shapeCount);
+    }
+
     // getType
     assert(elem1.getType() == ElementType::ELEMENT);
 
@@ -522,8 +672,30 @@ void runTests()
         {'0', '0'}
     };
     Element connector(2, 2, connectMat);
+    Element topElemForCheck(1, 1, std::vector<std::vector<char>>(1, std::vector<char>(1, '1')));
     assert(upperLayer.canPlaceWithLowerLayer(&connector, 0, 0, &lowerLayer) == true);
 
+    // checkLowerConnection возвращает первую клетку без гнезда
+    ConnectionCheck check = upperLayer.checkLowerConnection(&baseElem, 0, 0, &lowerLayer);
+    assert(check.connected == false);
+    assert(check.failX == 1 && check.failY == 0);
+    check = upperLayer.checkLowerConnection(&topElemForCheck, 1, 1, &lowerLayer);
+    assert(check.connected == true);
+
+    // getSocketWindow - гнезда нижнего слоя со смещением окна
+    std::vector<std::uint64_t> window;
+    lowerLayer.getSocketWindow(-1, 0, 4, 3, window);
+    assert(window.size() == 3);
+    assert(window[0] == 0xA);   // гнезда в (0,0) и (2,0) -> биты 1 и 3
+    assert(window[1] == 0x4);
+
+    // Векторное ядро: нарушение в слове, не кратном ширине вектора
+    std::vector<std::uint64_t> kernelConnectors(7, 0xF0), kernelSockets(7, 0xFF);
+    assert(findConnectionViolation(kernelConnectors.data(), kernelSockets.data(), 7) == -1);
+    kernelSockets[5] = 0x7F;
+    assert(findConnectionViolation(kernelConnectors.data(), kernelSockets.data(), 7) == 5);
+    assert(getConnectionKernelName() != nullptr);
+
     // Удаление элемента
     layer1.removeElement(0);
     assert(layer1.isEmpty() == true);
@@ -535,6 +707,72 @@ void runTests()
     assert(layer1.getMinX() == 10);
     assert(layer1.getMaxX() == 12);
 
+    // Границы пересчитываются и при удалении
+    layer1.placeElement(&connector, -5, 20);
+    assert(layer1.getMinX() == -5 && layer1.getMaxY() == 21);
+    assert(layer1.getWidth() == 18);
+    layer1.removeElement(1);
+    assert(layer1.getMinX() == 10 && layer1.getMaxY() == 12);
+    assert(layer1.getWidth() == 3);
+
+    // Пространственный индекс: большой элемент лежит в нескольких блоках
+    std::vector<std::vector<char>> bigMat(40, std::vector<char>(40, '0'));
+    Element bigElem(40, 40, bigMat);
+    for (SpatialIndexType indexType : {SpatialIndexType::LINEAR, SpatialIndexType::GRID}) {
+        Layer indexedLayer(indexType, 8);
+        assert(indexedLayer.getIndexType() == indexType);
+        assert(indexedLayer.placeElement(&bigElem, -20, -20) == true);
+        assert(indexedLayer.placeElement(&baseElem, 20, 20) == true);
+        assert(indexedLayer.hasOverlap(&baseElem, 18, 18) == true);
+        assert(indexedLayer.hasOverlap(&baseElem, 23, 20) == false);
+        assert(indexedLayer.getCell(-20, 19) == '0');
+        assert(indexedLayer.getCell(21, 20) == '1');
+        assert(indexedLayer.getCell(20, 23) == ' ');
+
+        Layer indexedCopy(indexedLayer);
+        indexedLayer.removeElement(0);
+        assert(indexedLayer.getCell(0, 0) == ' ');
+        assert(indexedLayer.hasOverlap(&baseElem, 0, 0) == false);
+        assert(indexedCopy.getCell(0, 0) == '0');
+        indexedLayer.clearLayer();
+        assert(indexedLayer.getCell(21, 20) == ' ');
+    }
+
+    // Крупный элемент сетки хранится одной записью, а не в каждом блоке
+    {
+        SpatialIndex grid(SpatialIndexType::GRID, 16);
+        size_t emptyMemory = grid.getMemoryUsage();
+        grid.insert(IndexEntry{&bigElem, 1, -100000, -100000, 200000, 200000});
+        grid.insert(IndexEntry{&baseElem, 2, 150000, 0, 3, 3});
+        assert(grid.size() == 2 && grid.getMemoryUsage() - emptyMemory < 1024);
+        assert(grid.intersectsAny(99999, 99999, 1, 1) && !grid.intersectsAny(100000, 0, 3, 3));
+        assert(grid.findAt(0, 0)->id == 1 && grid.findAt(150002, 2)->id == 2);
+        std::vector<IndexEntry> found;
+        grid.query(99990, 0, 50020, 1, found);
+        assert(found.size() == 2 && found[0].id == 1 && found[1].id == 2);
+        grid.remove(IndexEntry{&bigElem, 1, -100000, -100000, 200000, 200000});
+        assert(grid.size() == 1 && grid.findAt(0, 0) == nullptr);
+    }
+
+    // Растр слоя: отрицательные координаты, владельцы клеток, блоки по CHUNK клеток
+    Layer rasterLayer;
+    assert(rasterLayer.placeElement(&baseElem, -70, -2) == true);
+    assert(rasterLayer.placeElement(&connector, 100, 5) == true);
+    assert(rasterLayer.getCell(-69, -2) == '1');
+    assert(rasterLayer.getCell(101, 6) == '0');
+    assert(rasterLayer.getOwnerAt(-70, -2) == rasterLayer.getPlacementId(0));
+    assert(rasterLayer.getOwnerAt(100, 5) == rasterLayer.getPlacementId(1));
+    assert(rasterLayer.getOwnerAt(0, 0) == LayerRaster::NO_OWNER);
+    assert(rasterLayer.getRaster().getTileCount() == 3); // baseElem задевает два блока
+
+    Layer rasterCopy(rasterLayer);
+    rasterLayer.removeElement(0);
+    assert(rasterLayer.getCell(-69, -2) == ' ');
+    assert(rasterLayer.getOwnerAt(-69, -2) == LayerRaster::NO_OWNER);
+    assert(rasterLayer.getCell(101, 6) == '0');
+    assert(rasterLayer.getRaster().getTileCount() == 1); // пустые блоки освобождаются
+    assert(rasterCopy.getCell(-69, -2) == '1'); // копия хранит свой растр
+
     // ТЕСТИРОВАНИЕ SCHEME
     std::cout << "TESTING SCHEME..." << std::endl;
     Scheme scheme;
@@ -569,6 +807,99 @@ void runTests()
     // Валидация — должна пройти
     assert(scheme.validateStructure() == true);
 
+    // Инкрементальная проверка: удаление опоры ломает верхний слой
+    Violation violation;
+    assert(scheme.getFirstViolation(violation) == false);
+    Scheme brokenScheme(scheme);
+    assert(brokenScheme.removeElement(0, 0) == true);
+    assert(brokenScheme.validateStructure() == false);
+    assert(brokenScheme.getFirstViolation(violation) == true);
+    assert(violation.layerIndex == 1 && violation.elementIndex == 0);
+    assert(violation.x == 0 && violation.y == 0);
+    // Возврат опоры снова делает структуру корректной
+    assert(brokenScheme.addElement(&baseElem, 0, 0, 0) == true);
+    assert(brokenScheme.validateStructure() == true);
+    // Изменение слоя в обход схемы тоже замечается
+    brokenScheme.getLayer(0)->clearLayer();
+    assert(brokenScheme.validateStructure() == false);
+
+    // Параллельная проверка: все нарушения в порядке слоев и элементов
+    {
+        Scheme tallScheme;
+        tallScheme.createLayer();
+        for (int i = 0; i < 600; i++) {
+            assert(tallScheme.addElement(&baseElem, 0, i * 3, 0) == true);
+        }
+        tallScheme.createLayer();
+        for (int i = 0; i < 600; i++) {
+            assert(tallScheme.addElement(&topElem, 1, i * 3, 0) == true);
+        }
+        // Убираем две опоры в разных отрезках задач
+        Layer* base = tallScheme.getLayer(0);
+        base->removeElement(500);
+        base->removeElement(10);
+
+        ThreadPool pool(4);
+        assert(pool.getThreadCount() == 4);
+        std::vector<Violation> report;
+        assert(tallScheme.validateStructureParallel(pool, &report, false) == false);
+        assert(report.size() == 2);
+        assert(report[0].layerIndex == 1 && report[0].elementIndex == 10);
+        assert(report[1].elementIndex == 500 && report[1].x == 1500);
+
+        report.clear();
+        assert(tallScheme.validateStructureParallel(pool, &report) == false);
+        assert(report.size() == 1 && report[0].elementIndex == 10);
+
+        assert(tallScheme.addElement(&baseElem, 0, 30, 0) == true);
+        assert(tallScheme.addElement(&baseElem, 0, 1500, 0) == true);
+        assert(tallScheme.validateStructureParallel(pool) == true);
+        assert(tallScheme.validateStructure() == true);
+    }
+
+    // Пакетное добавление
+    {
+        Scheme batchScheme;
+        batchScheme.createLayer();
+        batchScheme.createLayer();
+        std::vector<Placement> batch = {
+            {&topElem, 1, 0, 0},      // стоит на элементе из этой же пачки
+            {&baseElem, 0, 0, 0},
+            {&baseElem, 0, 3, 0},
+        };
+        std::vector<PlacementStatus> results;
+        assert(batchScheme.addElements(batch, &results) == true);
+        assert(results[0] == PlacementStatus::PLACED);
+        assert(batchScheme.getLayer(0)->getElements().size() == 2);
+        assert(batchScheme.getLayer(0)->getWidth() == 6);
+        assert(batchScheme.validateStructure() == true);
+
+        // Ошибки: пересечение с пачкой, со слоем, нет соединения, нет слоя
+        std::vector<Placement> badBatch = {
+            {&baseElem, 0, 10, 0},
+            {&baseElem, 0, 11, 1},
+            {&baseElem, 0, 4, 2},
+            {&topElem, 1, 1, 0},
+            {&topElem, 7, 0, 0},
+            {&baseElem, 0, 20, 0},
+        };
+        assert(batchScheme.addElements(badBatch, &results) == false);
+        assert(results[0] == PlacementStatus::ROLLED_BACK);
+        assert(results[1] == PlacementStatus::OVERLAP_BATCH);
+        assert(results[2] == PlacementStatus::OVERLAP_EXISTING);
+        assert(results[3] == PlacementStatus::NO_CONNECTION);
+        assert(results[4] == PlacementStatus::INVALID_LAYER);
+        assert(batchScheme.getLayer(0)->getElements().size() == 2);
+        assert(batchScheme.getLayer(0)->getWidth() == 6);
+
+        // Без allOrNothing подходящие элементы остаются
+        assert(batchScheme.addElements(badBatch, &results, false) == false);
+        assert(results[0] == PlacementStatus::PLACED);
+        assert(results[5] == PlacementStatus::PLACED);
+        assert(batchScheme.getLayer(0)->getElements().size() == 4);
+        assert(batchScheme.validateStructure() == true);
+    }
+
     // Удаление элемента и слоя
     assert(scheme.removeElement(0, 0) == true);
     assert(scheme.removeLayer(1) == true);
@@ -579,6 +910,956 @@ void runTests()
     assert(schemeCopy.getLayerCount() == 1);
     assert(schemeCopy.getLayer(0)->isEmpty() == true);
 
+    // Пулы: слои и элементы схемы, устойчивые дескрипторы
+    {
+        Scheme pooledScheme;
+        pooledScheme.createLayer();
+        pooledScheme.createLayer();
+        PoolHandle topHandle = pooledScheme.getLayerHandle(1);
+        assert(pooledScheme.getLayer(topHandle) == pooledScheme.getLayer(1));
+        assert(pooledScheme.getLayerHandle(5) == INVALID_POOL_HANDLE);
+
+        ElementHandle brick = pooledScheme.createElement(3, 3, mat);
+        ElementHandle motorHandle = pooledScheme.createMotor(2, 2, motorMat, 40, 2);
+        assert(pooledScheme.getElement(brick)->getType() == ElementType::ELEMENT);
+        assert(pooledScheme.getElement(motorHandle)->getType() == ElementType::MOTOR);
+        assert(pooledScheme.getElementStore()->size() == 2);
+        assert(pooledScheme.addElement(pooledScheme.getElement(brick), 0, 0, 0) == true);
+
+        // Копия использует те же дескрипторы и то же хранилище элементов
+        Scheme pooledCopy(pooledScheme);
+        assert(pooledCopy.getLayer(topHandle) == pooledCopy.getLayer(1));
+        assert(pooledCopy.getLayer(topHandle) != pooledScheme.getLayer(1));
+        assert(pooledCopy.getElement(brick) == pooledScheme.getElement(brick));
+
+        // Удаленный слой делает дескриптор недействительным
+        assert(pooledScheme.removeLayer(1) == true);
+        assert(pooledScheme.getLayer(topHandle) == nullptr);
+        assert(pooledScheme.findLayerIndex(topHandle) == -1);
+        assert(pooledScheme.findLayerIndex(pooledScheme.getLayerHandle(0)) == 0);
+        pooledScheme.createLayer();
+        assert(pooledScheme.getLayerHandle(1) != topHandle); // ячейка та же, поколение новое
+
+        // Присваивание не разделяет слои
+        pooledScheme = pooledCopy;
+        assert(pooledScheme.getLayer(0) != pooledCopy.getLayer(0));
+        assert(pooledScheme.getLayer(0)->getElements().size() == 1);
+    }
+
+    // Копии схемы разделяют слои до первого изменения
+    {
+        std::vector<std::vector<char>> socketMat = {{'0', '0'}, {'0', '0'}};
+        std::vector<std::vector<char>> pegMat = {{'1', '1'}, {'1', '1'}};
+        Scheme original;
+        original.createLayer();
+        original.createLayer();
+        Element* socket = original.getElement(original.createElement(2, 2, socketMat));
+        Element* peg = original.getElement(original.createElement(2, 2, pegMat));
+        assert(original.addElement(socket, 0, 0, 0));
+        assert(original.addElement(socket, 0, 4, 0));
+        assert(original.addElement(peg, 1, 0, 0));
+        assert(original.validateStructure());
+
+        Scheme variant(original);
+        assert(variant.getLayer(0)->sharesDataWith(*original.getLayer(0)));
+        assert(variant.getLayer(1)->sharesDataWith(*original.getLayer(1)));
+        assert(variant.validateStructure());
+
+        // Изменение варианта отделяет только затронутый слой
+        assert(variant.addElement(peg, 1, 4, 0));
+        assert(!variant.getLayer(1)->sharesDataWith(*original.getLayer(1)));
+        assert(variant.getLayer(0)->sharesDataWith(*original.getLayer(0)));
+        assert(variant.getLayer(1)->getElements().size() == 2);
+        assert(original.getLayer(1)->getElements().size() == 1);
+        assert(original.getLayer(1)->getCell(4, 0) == ' ');
+        assert(variant.getLayer(1)->getCell(4, 0) == '1');
+
+        // Удаление из нижнего слоя варианта не ломает оригинал
+        assert(variant.removeElement(0, 0));
+        assert(variant.validateStructure() == false);
+        assert(original.validateStructure());
+        assert(original.getLayer(0)->getCell(0, 0) == '0');
+
+        Layer shared = *original.getLayer(0);
+        shared.clearLayer();
+        assert(shared.isEmpty() && !original.getLayer(0)->isEmpty());
+        assert(shared.getVersion() != original.getLayer(0)->getVersion());
+    }
+
+    // Журнал правок: undo/redo, транзакции, точка отката
+    {
+        std::vector<std::vector<char>> socketMat = {{'0', '0'}, {'0', '0'}};
+        std::vector<std::vector<char>> pegMat = {{'1', '1'}, {'1', '1'}};
+        Scheme edited;
+        Element* socket = edited.getElement(edited.createElement(2, 2, socketMat));
+        Element* peg = edited.getElement(edited.createElement(2, 2, pegMat));
+        assert(!edited.canUndo() && !edited.undo());
+
+        edited.createLayer();
+        edited.createLayer();
+        assert(edited.addElement(socket, 0, 0, 0));
+        assert(edited.addElement(socket, 0, 4, 0));
+        assert(edited.addElement(peg, 1, 0, 0));
+        assert(edited.getHistorySize() == 5);
+
+        // Удаление из середины слоя отменяется на прежнюю позицию
+        assert(edited.removeElement(0, 0));
+        assert(!edited.validateStructure());
+        assert(edited.undo());
+        assert(edited.getLayer(0)->getElements()[0].second.first == 0);
+        assert(edited.getLayer(0)->getElements()[1].second.first == 4);
+        assert(edited.validateStructure());
+        assert(edited.canRedo() && edited.redo());
+        assert(edited.getLayer(0)->getElements().size() == 1 && !edited.validateStructure());
+        assert(edited.undo());
+
+        // Новая правка сбрасывает redo
+        assert(edited.addElement(peg, 1, 4, 0));
+        assert(!edited.canRedo());
+        assert(edited.undo());
+        assert(edited.getLayer(1)->getElements().size() == 1);
+
+        // Транзакция и пачка отменяются одним шагом
+        edited.beginTransaction();
+        edited.createLayer();
+        assert(edited.addElement(socket, 2, 8, 0));
+        assert(!edited.canUndo());
+        assert(edited.commitTransaction());
+        std::vector<Placement> batch = {{socket, 0, 8, 0}, {peg, 1, 4, 0}};
+        assert(edited.addElements(batch));
+        assert(edited.getLayerCount() == 3);
+        assert(edited.undo());
+        assert(edited.getLayer(0)->getElements().size() == 2 && edited.getLayer(1)->getElements().size() == 1);
+        assert(edited.undo());
+        assert(edited.getLayerCount() == 2);
+        assert(edited.redo() && edited.getLayerCount() == 3 && edited.getLayer(2)->getCell(8, 0) == '0');
+        assert(edited.undo());
+
+        edited.beginTransaction();
+        assert(edited.removeElement(1, 0));
+        assert(edited.removeLayer(1));
+        assert(edited.rollbackTransaction());
+        assert(edited.getLayerCount() == 2 && edited.getLayer(1)->getCell(0, 0) == '1');
+        assert(edited.validateStructure());
+        assert(!edited.rollbackTransaction());
+
+        // Снимок и сворачивание старых шагов при ограниченной истории
+        edited.checkpoint();
+        assert(edited.getHistorySize() == 0);
+        edited.setHistoryLimit(2);
+        for (int i = 0; i < 4; i++) {
+            assert(edited.addElement(socket, 0, 10 + 2 * i, 0));
+        }
+        assert(edited.getHistorySize() == 2);
+        assert(edited.undo() && edited.undo() && !edited.undo());
+        assert(edited.getLayer(0)->getElements().size() == 4);
+        assert(edited.restoreCheckpoint());
+        assert(edited.getLayer(0)->getElements().size() == 4);
+        assert(edited.getLayer(0)->getCell(12, 0) == '0' && edited.getLayer(0)->getCell(14, 0) == ' ');
+        assert(edited.validateStructure());
+    }
+
+    // Учет памяти по структурам
+    {
+        std::vector<std::vector<char>> socketMat = {{'0', '0'}, {'0', '0'}};
+        Scheme measured;
+        measured.createLayer();
+        measured.createLayer();
+        Element* socket = measured.getElement(measured.createElement(2, 2, socketMat));
+        for (int i = 0; i < 50; i++) {
+            assert(measured.addElement(socket, 0, 2 * i, 0));
+        }
+        SchemeMemoryStats memory = measured.getMemoryStats();
+        assert(memory.layers.size() == 2);
+        assert(memory.layers[0].placements > memory.layers[1].placements);
+        assert(memory.layers[0].raster > 0 && memory.layers[0].index > 0 && memory.layers[0].bounds > 0);
+        assert(memory.layers[1].raster == 0 && memory.layers[1].bounds == 0);
+        assert(memory.shapes == socket->getShape().getMemoryUsage()); // одна форма на 50 элементов
+        assert(memory.elements > 0 && memory.journal > 0);
+        size_t sum = memory.shapes + memory.elements + memory.journal + memory.validation +
+                     memory.layers[0].total() + memory.layers[1].total();
+        assert(memory.total() == sum);
+        assert(!memory.layers[0].shared);
+#ifdef __linux__
+        assert(memory.process.available && memory.process.residentKb > 0);
+        assert(memory.process.peakKb >= memory.process.residentKb);
+#endif
+
+        Scheme fork(measured);
+        assert(fork.getMemoryStats().layers[0].shared);
+        assert(fork.getMemoryStats().journal < memory.journal);
+    }
+
+    // Счетчики и гистограммы задержек (собираются только с CONSTRUCTOR_METRICS)
+    {
+        std::vector<std::vector<char>> socketMat = {{'0', '0'}, {'0', '0'}};
+        std::vector<std::vector<char>> pegMat = {{'1', '1'}, {'1', '1'}};
+        resetMetrics();
+        Scheme counted;
+        counted.createLayer();
+        counted.createLayer();
+        Element* socket = counted.getElement(counted.createElement(2, 2, socketMat));
+        Element* peg = counted.getElement(counted.createElement(2, 2, pegMat));
+        assert(counted.addElement(socket, 0, 0, 0));
+        assert(!counted.addElement(socket, 0, 1, 1));  // пересечение
+        assert(!counted.addElement(peg, 1, 5, 5));     // нет гнезд
+        assert(!counted.addElement(peg, 7, 0, 0));     // нет слоя
+        std::vector<Placement> batch = {{peg, 1, 0, 0}, {socket, 0, 2, 0}};
+        assert(counted.addElements(batch));
+        counted.getLayer(0)->getCell(0, 0);
+        assert(counted.validateStructure());
+        assert(counted.removeElement(1, 0));
+        ThreadPool metricsPool(2);
+        assert(counted.validateStructureParallel(metricsPool));
+
+        MetricsSnapshot metrics = getMetrics();
+#ifdef CONSTRUCTOR_METRICS
+        assert(metrics.enabled);
+        assert(metrics.get(MetricCounter::PLACEMENTS_ACCEPTED) == 3);
+        assert(metrics.get(MetricCounter::REJECTED_OVERLAP) == 1);
+        assert(metrics.get(MetricCounter::REJECTED_NO_CONNECTION) == 1);
+        assert(metrics.get(MetricCounter::REJECTED_INVALID_LAYER) == 1);
+        assert(metrics.get(MetricCounter::OVERLAP_CALLS) >= 4);
+        assert(metrics.get(MetricCounter::OVERLAP_SCANNED) >= 1);
+        assert(metrics.get(MetricCounter::GET_CELL_CALLS) >= 1);
+        assert(metrics.get(MetricCounter::CONNECTION_CHECKS) >= 2);
+        assert(metrics.get(MetricCounter::CELLS_COMPARED) == 4 * metrics.get(MetricCounter::CONNECTION_CHECKS));
+        const LatencyHistogram& adds = metrics.get(MetricTimer::ADD_ELEMENT);
+        assert(adds.count == 4 && adds.totalNs > 0);
+        assert(adds.percentileNs(0.5) <= adds.percentileNs(0.99));
+        assert(metrics.get(MetricTimer::REMOVE_ELEMENT).count == 1);
+        assert(metrics.get(MetricTimer::VALIDATE_STRUCTURE).count == 1);
+        resetMetrics();
+        assert(getMetrics().get(MetricCounter::OVERLAP_CALLS) == 0);
+#else
+        assert(!metrics.enabled);
+        assert(metrics.get(MetricCounter::OVERLAP_CALLS) == 0);
+        assert(metrics.get(MetricTimer::ADD_ELEMENT).count == 0);
+#endif
+    }
+
+    // Кадр слоя строится от minY, а не от нуля; окно и обзор
+    {
+        Element offsetElem(2, 2, {{'1', '0'}, {' ', '0'}});
+        Layer offsetLayer;
+        assert(offsetLayer.placeElement(&offsetElem, 5, 7));
+
+        std::string full;
+        offsetLayer.render(full, Rect{5, 7, 2, 2});
+        assert(full.find("Bounds: X[5..6] Y[7..8]\n") != std::string::npos);
+        assert(full.find("I____I\n|1 0 |\n|  0 |\nI____I\n") != std::string::npos);
+        assert(full.find("View") == std::string::npos);
+        assert(full.find("  1. Element at (5,7) size: 2x2\n") != std::string::npos);
+
+        std::string clipped;
+        offsetLayer.render(clipped, Rect{6, 7, 1, 2});
+        assert(clipped.find("View: X[6..6] Y[7..8], scale 1:1\n") != std::string::npos);
+        assert(clipped.find("I__I\n|0 |\n|0 |\nI__I\n") != std::string::npos);
+
+        assert(offsetLayer.getOverviewScale(1) == 2);
+        std::string overview;
+        offsetLayer.render(overview, Rect{5, 7, 2, 2}, 2);
+        assert(overview.find("I__I\n|1 |\nI__I\n") != std::string::npos);
+
+        Scheme rendered;
+        rendered.createLayer();
+        rendered.addElement(&offsetElem, 0, 5, 7);
+        std::stringstream captured;
+        std::streambuf* originalOut = std::cout.rdbuf(captured.rdbuf());
+        rendered.displayOverview(1);
+        std::cout.rdbuf(originalOut);
+        std::string text = captured.str();
+        assert(text.find("=== SCHEME (1 layers) ===\n--- LAYER 0 ---\n") == 0);
+        assert(text.find("|1 |\n") != std::string::npos);
+        assert(text.find("Structure is valid\n") != std::string::npos);
+    }
+
+    // findPlacements совпадает с поэлементной проверкой, в том числе
+    // на стыках 64-битных слов
+    {
+        Scheme search;
+        search.createLayer();
+        search.createLayer();
+        Element* base = search.getElement(search.createElement(3, 2, {{'0', '0', '0'}, {'0', '1', '0'}}));
+        Element* probe = search.getElement(search.createElement(2, 2, {{'1', ' '}, {'0', '1'}}));
+        for (int i = 0; i < 30; i++) {
+            search.addElement(base, 0, i * 5 - 7, (i * 7) % 9);
+        }
+        search.addElement(probe, 1, 63, 0);
+        search.addElement(probe, 1, 3, 6);
+
+        Rect region = {-10, -2, 160, 14};
+        std::vector<std::pair<int, int>> found = search.findPlacements(probe, 1, region);
+        std::vector<std::pair<int, int>> expected;
+        const Layer* upper = search.getLayer(1);
+        for (int y = region.y; y < region.y + region.height; y++) {
+            for (int x = region.x; x < region.x + region.width; x++) {
+                if (!upper->hasOverlap(probe, x, y) &&
+                    upper->checkLowerConnection(probe, x, y, search.getLayer(0)).connected) {
+                    expected.push_back(std::make_pair(x, y));
+                }
+            }
+        }
+        assert(!expected.empty());
+        assert(found == expected);
+        // Вне нижнего слоя гнезд нет: огромная область не раздувает поиск
+        assert(search.findPlacements(probe, 1, Rect{-1000000, -1000000, 2000000, 2000000}) == found);
+
+        // Без проверки гнезд углы вокруг слоя заведомо свободны
+        Rect around = {-12, -3, 170, 16};
+        std::vector<std::pair<int, int>> free;
+        for (int y = around.y; y < around.y + around.height; y++) {
+            for (int x = around.x; x < around.x + around.width; x++) {
+                if (!search.getLayer(0)->hasOverlap(base, x, y)) {
+                    free.push_back(std::make_pair(x, y));
+                }
+            }
+        }
+        assert(search.findPlacements(base, 0, around) == free);
+
+        std::vector<std::pair<int, int>> firstTwo = search.findPlacements(probe, 1, region, 2);
+        assert(firstTwo.size() == 2 && firstTwo[0] == expected[0] && firstTwo[1] == expected[1]);
+
+        // На нижнем слое соединение не проверяется, только пересечения
+        std::vector<std::pair<int, int>> ground = search.findPlacements(base, 0, Rect{-7, 0, 3, 2});
+        for (const auto& position : ground) {
+            assert(!search.getLayer(0)->hasOverlap(base, position.first, position.second));
+        }
+        assert(search.findPlacements(probe, 5, region).empty());
+        int before = search.getLayer(1)->getElements().size();
+        assert(search.addElement(probe, 1, found.back().first, found.back().second));
+        assert(search.getLayer(1)->getElements().size() == before + 1);
+    }
+
+    // Автосборка: решение всегда проходит проверку структуры
+    {
+        Element socketPiece(2, 2, {{'0', '0'}, {'0', '0'}});
+        Element pegPiece(2, 2, {{'1', '1'}, {'1', '1'}});
+        std::vector<SolverPiece> bag = {{&pegPiece, 4}, {&socketPiece, 4}};
+        Rect area = {0, 0, 4, 4};
+        ThreadPool solverPool(4);
+
+        SolverOptions solverOptions;
+        solverOptions.timeBudget = std::chrono::milliseconds(5000);
+        SolverResult connected = AssemblySolver(bag, area, solverOptions).solve(solverPool);
+        assert(connected.connectorsUsed == 16);
+        assert(connected.piecesPlaced == 8 && connected.placements.size() == 8);
+        assert(!connected.timedOut && connected.statesExpanded > 0);
+        Scheme assembled;
+        assert(connected.buildScheme(assembled));
+        assert(assembled.getLayerCount() == connected.layerCount);
+        assert(assembled.validateStructure());
+        for (const Placement& placement : connected.placements) {
+            assert(placement.x >= area.x && placement.x + 2 <= area.x + area.width);
+            assert(placement.y >= area.y && placement.y + 2 <= area.y + area.height);
+        }
+        assert(!connected.buildScheme(assembled)); // схема уже не пуста
+
+        solverOptions.goal = SolverGoal::MIN_LAYERS;
+        solverOptions.maxLayers = 3;
+        SolverResult compact = AssemblySolver(bag, area, solverOptions).solve(solverPool);
+        assert(compact.piecesPlaced == 8 && compact.layerCount == 2);
+        Scheme compactScheme;
+        assert(compact.buildScheme(compactScheme) && compactScheme.validateStructure());
+
+        // Бюджет исчерпан сразу - остается лучшее найденное (здесь пустое)
+        solverOptions.timeBudget = std::chrono::milliseconds(0);
+        SolverResult rushed = AssemblySolver(bag, area, solverOptions).solve(solverPool);
+        assert(rushed.timedOut && rushed.placements.empty());
+        Scheme rushedScheme;
+        assert(rushed.buildScheme(rushedScheme) && rushedScheme.validateStructure());
+    }
+
+    // Ориентации: формы считаются один раз и общие через реестр
+    {
+        Element corner(3, 2, {{'1', '0', '0'}, {'0', ' ', ' '}});
+        Element* turned = corner.getOriented(Orientation::R90);
+        assert(turned->getWidth() == 2 && turned->getHeight() == 3);
+        assert(turned->getMatrix() == std::vector<std::vector<char>>({{'0', '1'}, {' ', '0'}, {' ', '0'}}));
+        assert(corner.getOriented(Orientation::R90) == turned);
+        assert(corner.getOriented(Orientation::R0) == &corner);
+        Element* flipped = corner.getOriented(Orientation::FLIP_R0);
+        assert(flipped->getMatrix() == std::vector<std::vector<char>>({{'0', '0', '1'}, {' ', ' ', '0'}}));
+        Element* upsideDown = corner.getOriented(Orientation::R180);
+        assert(upsideDown->getMatrix() == std::vector<std::vector<char>>({{' ', ' ', '0'}, {'0', '0', '1'}}));
+        assert(turned->getOriented(Orientation::R270)->hasSameShape(corner));
+        Element typed(2, 3, {{'0', '1'}, {' ', '0'}, {' ', '0'}});
+        assert(typed.hasSameShape(*turned));
+        assert(corner.getDistinctOrientations().size() == 8);
+
+        Element square(2, 2, {{'0', '0'}, {'0', '0'}});
+        assert(square.getDistinctOrientations().size() == 1);
+        Element tip(2, 2, {{'1', '0'}, {'0', '0'}});
+        assert(tip.getDistinctOrientations().size() == 4);
+
+        // Варианты создаются один раз и при одновременных запросах
+        Element racing(3, 1, {{'1', '0', '0'}});
+        std::vector<Element*> seenVariants(8);
+        ThreadPool orientPool(4);
+        for (int t = 0; t < 8; t++) {
+            orientPool.submit([&racing, &seenVariants, t]() {
+                seenVariants[t] = racing.getOriented(Orientation::FLIP_R90);
+            });
+        }
+        orientPool.wait();
+        for (Element* variant : seenVariants) assert(variant == seenVariants[0]);
+
+        Motor spinner(1, 2, {{'1'}, {'0'}}, 40, 1);
+        Element* spinnerTurned = spinner.getOriented(Orientation::R90);
+        assert(spinnerTurned->getType() == ElementType::MOTOR);
+        assert(static_cast<Motor*>(spinnerTurned)->getSpeed() == 40);
+        assert(spinnerTurned->getWidth() == 2 && spinnerTurned->getHeight() == 1);
+
+        // Перегрузки слоя и схемы размещают вариант
+        Scheme oriented;
+        oriented.createLayer();
+        oriented.createLayer();
+        Element* base = oriented.getElement(oriented.createElement(2, 3, {{'0', '0'}, {'0', '0'}, {'0', '0'}}));
+        Element* bar = oriented.getElement(oriented.createElement(3, 1, {{'1', '1', '1'}}));
+        assert(oriented.addElement(base, 0, 0, 0));
+        assert(!oriented.getLayer(1)->canPlaceWithLowerLayer(bar, 0, 0, oriented.getLayer(0)));
+        assert(oriented.getLayer(1)->canPlaceWithLowerLayer(bar, Orientation::R90, 0, 0, oriented.getLayer(0)));
+        assert(oriented.addElement(bar, Orientation::R90, 1, 1, 0));
+        assert(oriented.getLayer(1)->getElements()[0].first == bar->getOriented(Orientation::R90));
+        assert(oriented.getLayer(1)->hasOverlap(bar, Orientation::R270, 1, 2));
+        assert(!oriented.getLayer(1)->hasOverlap(bar, Orientation::R90, 0, 0));
+        assert(oriented.validateStructure());
+
+        Layer plain;
+        assert(plain.placeElement(&corner, Orientation::FLIP_R270, 0, 0));
+        assert(plain.getWidth() == 2 && plain.getHeight() == 3);
+        assert(!plain.placeElement(nullptr, Orientation::R90, 5, 5));
+    }
+
+    // Граф соединений: добавления учитываются сразу, отмена - откатом
+    {
+        Scheme joined;
+        joined.createLayer();
+        joined.createLayer();
+        Element* pad = joined.getElement(joined.createElement(2, 2, {{'0', '0'}, {'0', '0'}}));
+        Element* bridge = joined.getElement(joined.createElement(6, 1, {{'1', ' ', ' ', ' ', ' ', '1'}}));
+        Element* pin = joined.getElement(joined.createElement(1, 1, {{'1'}}));
+        assert(joined.getComponentCount() == 0);
+        assert(joined.addElement(pad, 0, 0, 0));
+        assert(joined.addElement(pad, 0, 4, 0));
+        assert(joined.getComponentCount() == 2 && !joined.areConnected(0, 0, 0, 1));
+        assert(joined.addElement(bridge, 1, 0, 0));
+        assert(joined.getComponentCount() == 1 && joined.areConnected(0, 0, 0, 1));
+        assert(joined.addElement(pin, 1, 1, 1));
+        assert(joined.getComponentCount() == 1 && joined.getConnectionCount() == 3);
+        assert(joined.getComponentId(1, 1) == joined.getComponentId(0, 1));
+        assert(joined.getComponentId(3, 0) == -1 && !joined.areConnected(0, 0, 0, 7));
+
+        assert(joined.addElement(pad, 0, 10, 10));
+        assert(joined.getComponentCount() == 2 && !joined.areConnected(0, 2, 1, 0));
+        Scheme rebuilt(joined); // копия строит граф с нуля
+        assert(rebuilt.getComponentCount() == 2 && rebuilt.getConnectionCount() == 3);
+        assert(joined.undo());
+        assert(joined.getComponentCount() == 1 && joined.getConnectionCount() == 3);
+
+        // Удаление не последнего элемента - перестроение: штырь повис
+        assert(joined.removeElement(0, 0));
+        assert(joined.getComponentCount() == 2 && joined.getConnectionCount() == 1);
+        assert(joined.areConnected(0, 0, 1, 0) && !joined.areConnected(1, 0, 1, 1));
+        assert(joined.undo());
+        assert(joined.getComponentCount() == 1 && joined.getConnectionCount() == 3);
+
+        // Правка слоя в обход схемы видна по версии
+        joined.getLayer(1)->removeElement(0);
+        assert(joined.getComponentCount() == 2 && joined.getConnectionCount() == 1);
+        assert(joined.areConnected(0, 0, 1, 0) && !joined.areConnected(0, 1, 1, 0));
+        joined.createLayer();
+        assert(!joined.addElement(pin, 2, 1, 1)); // соединитель на соединителе
+        assert(joined.getComponentCount() == 2);
+    }
+
+    // Симуляция: вращение идет по цепи соединений, направление чередуется
+    {
+        Scheme machine;
+        machine.createLayer();
+        machine.createLayer();
+        machine.createLayer();
+        Element* drive = machine.getElement(machine.createMotor(2, 1, {{'0', '0'}}, 10, 1));
+        Element* gear = machine.getElement(machine.createElement(2, 1, {{'1', '0'}}));
+        Element* cap = machine.getElement(machine.createElement(1, 1, {{'1'}}));
+        Element* idle = machine.getElement(machine.createElement(1, 1, {{'0'}}));
+        assert(machine.addElement(drive, 0, 0, 0));
+        assert(machine.addElement(idle, 0, 5, 5));
+        assert(machine.addElement(gear, 1, 0, 0));
+        assert(machine.addElement(cap, 2, 1, 0));
+
+        MotorSimulation simulation(machine, 1.0 / 60);
+        assert(simulation.getNodeCount() == 4 && simulation.getMotorCount() == 1);
+        assert(simulation.isDriven(2, 0) && !simulation.isDriven(0, 1));
+        assert(simulation.getDirection(0, 0) == 1 && simulation.getDirection(1, 0) == 2);
+        assert(simulation.getDirection(2, 0) == 1 && simulation.getSpeed(2, 0) == 10.0f);
+        simulation.run(60);
+        assert(simulation.getTickCount() == 60 && std::abs(simulation.getTime() - 1.0) < 1e-9);
+        assert(std::abs(simulation.getAngle(0, 0) - 60.0f) < 0.01f);  // 10 об/мин = 60 градусов/с
+        assert(std::abs(simulation.getAngle(1, 0) - 300.0f) < 0.01f); // против часовой
+        assert(std::abs(simulation.getAngle(2, 0) - 60.0f) < 0.01f);
+        assert(simulation.getAngle(0, 1) == 0.0f && simulation.getConflicts().empty());
+
+        // Второй мотор под той же шестерней: согласованный привод не мешает
+        Element* wide = machine.getElement(machine.createElement(4, 1, {{'1', ' ', ' ', '1'}}));
+        Element* helper = machine.getElement(machine.createMotor(2, 1, {{'0', '0'}}, 10, 1));
+        assert(machine.addElement(helper, 0, 3, 0));
+        assert(machine.removeElement(2, 0) && machine.removeElement(1, 0));
+        assert(machine.addElement(wide, 1, 0, 0));
+        simulation.rebuild(machine);
+        assert(simulation.getMotorCount() == 2 && simulation.getConflicts().empty());
+        assert(simulation.getDirection(1, 0) == 2 && !simulation.isJammed(1, 0));
+
+        // Встречное вращение заклинивает всю сборку, но не чужие элементы
+        static_cast<Motor*>(helper)->setDirection(2);
+        simulation.propagate();
+        assert(simulation.getConflicts().size() == 1);
+        assert(simulation.isJammed(0, 0) && simulation.isJammed(1, 0) && simulation.isJammed(0, 2));
+        assert(!simulation.isJammed(0, 1) && !simulation.isDriven(1, 0));
+        simulation.tick();
+        assert(simulation.getSpeed(1, 0) == 0.0f && simulation.getAngle(1, 0) == 0.0f);
+        static_cast<Motor*>(helper)->stop();
+        simulation.propagate();
+        assert(simulation.getConflicts().empty() && simulation.isDriven(0, 2));
+    }
+
+    // Реестр моторов: состояние в массивах, Motor - представление ячейки
+    {
+        Scheme fleet;
+        fleet.createLayer();
+        fleet.createLayer();
+        MotorRegistry& motors = fleet.getMotors();
+        Motor* first = static_cast<Motor*>(fleet.getElement(fleet.createMotor(1, 1, {{'0'}}, 10, 1)));
+        Motor* second = static_cast<Motor*>(fleet.getElement(fleet.createMotor(1, 1, {{'0'}}, 20, 2)));
+        ElementHandle idleHandle = fleet.createMotor(1, 1, {{'0'}});
+        Motor* idle = static_cast<Motor*>(fleet.getElement(idleHandle));
+        assert(motors.size() == 3 && motors.countRunning() == 2);
+        assert(first->getRegistry() == &motors && motors.getMotor(first->getRegistrySlot()) == first);
+        first->setSpeed(30);
+        assert(motors.getSpeed(first->getRegistrySlot()) == 30);
+
+        // Повернутый мотор смотрит в ту же ячейку, копия - отдельный мотор
+        Motor* turned = static_cast<Motor*>(first->getOriented(Orientation::R90));
+        Motor copy(*first);
+        assert(turned->getSpeed() == 30 && copy.getRegistry() == nullptr && copy.getSpeed() == 30);
+        copy.setSpeed(5);
+        assert(first->getSpeed() == 30);
+
+        assert(motors.scaleSpeeds(0.5f) && first->getSpeed() == 15 && second->getSpeed() == 10);
+        assert(turned->getSpeed() == 15 && idle->getSpeed() == 0);
+        assert(motors.scaleSpeeds(10.0f) && first->getSpeed() == 100 && !motors.scaleSpeeds(-1.0f));
+        assert(motors.setDirectionWhere([](int, int, bool running) { return running; }, 2) == 2);
+        assert(first->getDirection() == 2 && idle->getDirection() == 0);
+        assert(motors.setDirectionWhere([](int, int, bool) { return true; }, 3) == 0);
+
+        // По слою - и моторы хранилища, и отдельные
+        Motor loose(1, 1, {{'0'}}, 5, 2);
+        assert(fleet.addElement(first, 0, 0, 0));
+        assert(fleet.addElement(second, 1, 0, 0) && fleet.addElement(&loose, 1, 2, 0));
+        assert(fleet.setMotorDirectionOnLayer(1, 1) && !fleet.setMotorDirectionOnLayer(2, 1));
+        assert(second->getDirection() == 1 && loose.getDirection() == 1 && first->getDirection() == 2);
+
+        std::vector<Motor*> runningMotors = fleet.getRunningMotors();
+        assert(runningMotors.size() == 2 && runningMotors[0] == first && runningMotors[1] == second);
+        motors.stopAll();
+        assert(motors.countRunning() == 0 && !turned->getStatus() && first->getSpeed() == 0);
+        assert(fleet.getElementStore()->destroy(idleHandle) && motors.size() == 2);
+        assert(!fleet.getElementStore()->destroy(idleHandle) && fleet.getRunningMotors().empty());
+    }
+
+    // Диагностика: без приемника ядро молчит, сборщик получает все нарушения
+    {
+        Scheme checked;
+        checked.createLayer();
+        checked.createLayer();
+        Element* socket = checked.getElement(checked.createElement(1, 1, {{'0'}}));
+        Element* peg = checked.getElement(checked.createElement(1, 1, {{'1'}}));
+        assert(getDiagnosticSink() == nullptr);
+        assert(!checked.addElement(peg, 1, 0, 0)); // никуда не сообщается
+
+        DiagnosticCollector collector;
+        {
+            ScopedDiagnosticSink attach(collector);
+            assert(!checked.addElement(peg, 3, 0, 0));
+            assert(!checked.addElement(nullptr, 0, 0, 0));
+            assert(!checked.addElement(peg, 1, 4, 2));
+            assert(checked.addElement(socket, 0, 0, 0) && checked.addElement(socket, 0, 5, 0));
+            assert(!checked.addElement(socket, 0, 0, 0));
+            assert(checked.addElement(peg, 1, 0, 0) && checked.addElement(peg, 1, 5, 0));
+            assert(!checked.removeElement(0, 7) && !checked.removeLayer(0));
+        }
+        assert(getDiagnosticSink() == nullptr);
+        std::vector<Diagnostic> reported = collector.getDiagnostics();
+        assert(reported.size() == 6);
+        assert(reported[0].code == DiagnosticCode::LAYER_NOT_FOUND && reported[0].layerIndex == 3);
+        assert(reported[1].code == DiagnosticCode::INVALID_ELEMENT);
+        assert(reported[2].code == DiagnosticCode::NO_CONNECTION && reported[2].layerIndex == 1);
+        assert(reported[2].x == 4 && reported[2].y == 2 && reported[2].element == peg);
+        assert(reported[3].code == DiagnosticCode::OVERLAP && reported[3].layerIndex == 0);
+        assert(reported[4].code == DiagnosticCode::ELEMENT_NOT_FOUND && reported[4].elementIndex == 7);
+        assert(reported[5].code == DiagnosticCode::LAYER_NOT_EMPTY);
+
+        // Проверка структуры сообщает каждое нарушение, а не первое
+        assert(checked.removeElement(0, 1) && checked.removeElement(0, 0));
+        collector.clear();
+        {
+            ScopedDiagnosticSink attach(collector);
+            assert(!checked.validateStructure());
+        }
+        reported = collector.getDiagnostics();
+        assert(reported.size() == 2 && collector.count(DiagnosticCode::BROKEN_CONNECTION) == 2);
+        assert(reported[0].layerIndex == 1 && reported[0].elementIndex == 0 && reported[0].x == 0);
+        assert(reported[1].elementIndex == 1 && reported[1].x == 5 && reported[1].y == 0);
+
+        // Элементы и моторы
+        Element shaped(1, 1, {{'0'}});
+        Motor spinner(1, 1, {{'0'}}, 10, 1);
+        collector.clear();
+        {
+            ScopedDiagnosticSink attach(collector);
+            shaped.setMatrix({{'0', 'x'}});
+            shaped.setMatrix({});
+            spinner.rotate(500, 7);
+        }
+        reported = collector.getDiagnostics();
+        assert(reported.size() == 4 && shaped.getWidth() == 1 && spinner.getSpeed() == 10);
+        assert(reported[0].code == DiagnosticCode::INVALID_MATRIX_CELL && reported[0].x == 1 && reported[0].value == 'x');
+        assert(reported[1].code == DiagnosticCode::EMPTY_MATRIX && reported[1].element == &shaped);
+        assert(reported[2].code == DiagnosticCode::INVALID_SPEED && reported[2].value == 500);
+        assert(reported[3].code == DiagnosticCode::INVALID_DIRECTION && reported[3].value == 7);
+
+        // Пакетный режим перечисляет все нарушения
+        std::ostringstream batchOut, batchErr;
+        BatchRunner runner(checked, batchOut, batchErr);
+        std::istringstream validateScript("validate\n");
+        assert(runner.run(validateScript) == 0 && batchOut.str() ==
+               "invalid: layer 1 element 0 at (0, 0)\ninvalid: layer 1 element 1 at (5, 0)\n");
+    }
+
+    // Размещенный элемент изменили: слой снимает его по форме на момент размещения
+    {
+        Scheme reshaped;
+        reshaped.createLayer();
+        Element* grown = reshaped.getElement(reshaped.createElement(2, 2, {{'0', '0'}, {'0', '0'}}));
+        Element* far = reshaped.getElement(reshaped.createElement(1, 1, {{'0'}}));
+        assert(reshaped.addElement(grown, 0, 0, 0) && reshaped.addElement(far, 0, 10, 10));
+        grown->setWidth(5);
+        grown->setHeight(6);
+        const Layer* layer = reshaped.getLayer(0);
+        assert(layer->getPlacedShape(0).getWidth() == 2 && layer->getPlacedShape(0).getHeight() == 2);
+        assert(layer->getMinX() == 0 && layer->getMaxX() == 10);
+        // Индекс хранит прямоугольник размещения, а не текущий размер
+        assert(reshaped.addElement(far, 0, 3, 3) && !reshaped.addElement(far, 0, 1, 1));
+        assert(reshaped.removeElement(0, 0));
+        assert(layer->getMinX() == 3 && layer->getMaxX() == 10);
+        std::vector<IndexEntry> left;
+        layer->findElementsIn(Rect{0, 0, 11, 11}, left);
+        assert(left.size() == 2 && left[0].width == 1 && left[1].width == 1);
+        assert(reshaped.addElement(far, 0, 1, 1));
+    }
+
+    // Смена формы не трогает уже выданные повернутые варианты
+    {
+        Scheme reshaped;
+        reshaped.createLayer();
+        Element* bar = reshaped.getElement(reshaped.createElement(3, 2, {{'0', '0', '0'}, {'0', '0', '0'}}));
+        assert(reshaped.addElement(bar, Orientation::R90, 0, 0, 0));
+        Element* placed = reshaped.getLayer(0)->getElements()[0].first;
+        bar->setMatrix({{'0'}});
+        assert(placed->getWidth() == 2 && placed->getHeight() == 3);
+        Element* turned = bar->getOriented(Orientation::R90);
+        assert(turned != placed && turned->getWidth() == 1 && turned->getHeight() == 1);
+        assert(reshaped.validateStructure());
+        assert(reshaped.removeElement(0, 0));
+        assert(reshaped.getLayer(0)->isEmpty());
+    }
+
+    // Далекие друг от друга элементы не раздувают растр, а координаты,
+    // при которых края слоя не помещаются в int, отклоняются
+    {
+        Scheme sparse;
+        sparse.createLayer();
+        sparse.createLayer();
+        Element* cell = sparse.getElement(sparse.createElement(1, 1, {{'0'}}));
+        assert(sparse.addElement(cell, 0, 0, 0) && sparse.addElement(cell, 0, 100000, 100000));
+        assert(sparse.addElement(cell, 0, Layer::MIN_COORDINATE, Layer::MIN_COORDINATE) &&
+               sparse.addElement(cell, 0, Layer::MAX_COORDINATE, Layer::MAX_COORDINATE));
+        const Layer* layer = sparse.getLayer(0);
+        assert(layer->getRaster().getTileCount() == 4);
+        assert(layer->getCell(100000, 100000) == '0' && layer->getCell(99999, 100000) == ' ');
+        assert(layer->getWidth() == Layer::MAX_COORDINATE - Layer::MIN_COORDINATE + 1);
+
+        DiagnosticCollector rejected;
+        {
+            ScopedDiagnosticSink scope(rejected);
+            assert(!sparse.addElement(cell, 0, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()));
+            assert(!sparse.addElement(cell, 0, -2000000000, -2000000000));
+            assert(!sparse.addElement(cell, 0, std::numeric_limits<int>::min(), 0));
+            assert(!sparse.addElement(cell, 1, Layer::MAX_COORDINATE + 1, 0));
+        }
+        assert(rejected.count(DiagnosticCode::OUT_OF_RANGE) == 4);
+        assert(layer->getElements().size() == 4);
+
+        std::vector<PlacementStatus> results;
+        assert(!sparse.addElements({Placement{cell, 0, Layer::MAX_COORDINATE, 0},
+                                    Placement{cell, 0, Layer::MIN_COORDINATE - 1, 0}}, &results, false));
+        assert(results[0] == PlacementStatus::PLACED && results[1] == PlacementStatus::OUT_OF_RANGE);
+        // Поиск мест не выходит за допустимые координаты
+        std::vector<std::pair<int, int>> edge = sparse.findPlacements(cell, 1, Rect{Layer::MAX_COORDINATE - 1, 0, 1000, 1});
+        assert(edge.size() == 2 && edge[1].first == Layer::MAX_COORDINATE);
+        assert(sparse.removeElement(0, 1));
+        assert(layer->getRaster().getTileCount() == 4 && layer->getCell(100000, 100000) == ' ');
+    }
+
+    // Большая область поиска: память не зависит от ее размера, limit
+    // останавливает обход, проверяемая часть идет полосами строк
+    {
+        Scheme wide;
+        wide.createLayer();
+        Element* cell = wide.getElement(wide.createElement(1, 1, {{'0'}}));
+        std::vector<std::pair<int, int>> first = wide.findPlacements(cell, 0, Rect{0, 0, 1000000, 1000000}, 1);
+        assert(first.size() == 1 && first[0] == std::make_pair(0, 0));
+
+        const int WALL = 100000;
+        Element* wall = wide.getElement(wide.createElement(WALL, 1, {std::vector<char>(WALL, '0')}));
+        for (int y = 0; y < 60; y += 2) {
+            assert(wide.addElement(wall, 0, 0, y));
+        }
+        std::vector<std::pair<int, int>> next = wide.findPlacements(cell, 0, Rect{-2, 0, 1000000, 1000000}, 3);
+        assert(next.size() == 3 && next[0] == std::make_pair(-2, 0) && next[1] == std::make_pair(-1, 0) &&
+               next[2] == std::make_pair(WALL, 0));
+        std::vector<std::pair<int, int>> rows = wide.findPlacements(cell, 0, Rect{0, 0, WALL, 60});
+        assert(rows.size() == static_cast<std::size_t>(30) * WALL);
+        for (std::size_t i = 0; i < rows.size(); i++) {
+            assert(rows[i].first == static_cast<int>(i % WALL) && rows[i].second == static_cast<int>(i / WALL) * 2 + 1);
+        }
+    }
+
+    // Размещенный элемент проверяется и выводится по форме на момент размещения
+    {
+        Scheme resized;
+        resized.createLayer();
+        resized.createLayer();
+        Element floor(3, 1, {{'0', '0', '1'}});
+        Element peg(1, 1, {{'1'}});
+        assert(resized.addElement(&floor, 0, 0, 0) && resized.addElement(&peg, 1, 0, 0));
+        peg.setMatrix({{'1', '1', '1'}});
+        assert(!resized.getLayer(1)->checkLowerConnection(&peg, 0, 0, resized.getLayer(0)).connected);
+
+        Scheme fresh(resized); // без кэша: проверка всех размещений заново
+        Violation violation;
+        assert(fresh.validateStructure() && !fresh.getFirstViolation(violation));
+        ThreadPool resizedPool(2);
+        std::vector<Violation> report;
+        assert(fresh.validateStructureParallel(resizedPool, &report, false) && report.empty());
+        assert(fresh.areConnected(1, 0, 0, 0));
+
+        std::string frame;
+        fresh.getLayer(1)->render(frame, Rect{0, 0, 1, 1});
+        assert(frame.find("size: 1x1") != std::string::npos);
+    }
+
+    // Хранилище не удаляет элементы, на которые ссылаются слои или история
+    {
+        Scheme owner;
+        owner.createLayer();
+        std::shared_ptr<ElementStore> store = owner.getElementStore();
+        ElementHandle placedHandle = owner.createElement(2, 1, {{'0', '1'}});
+        ElementHandle turnedHandle = owner.createMotor(2, 1, {{'1', '0'}});
+        ElementHandle freeHandle = owner.createElement(1, 1, {{'0'}});
+        assert(owner.addElement(owner.getElement(placedHandle), 0, 0, 0));
+        assert(owner.addElement(owner.getElement(turnedHandle), Orientation::R90, 0, 5, 0));
+        assert(!store->destroy(placedHandle) && !store->destroy(turnedHandle));
+        assert(store->destroy(freeHandle) && !store->destroy(freeHandle));
+
+        // Копия схемы с тем же хранилищем держит свои слои,
+        // а снятый со слоя элемент еще нужен для undo
+        Scheme copy(owner);
+        assert(owner.removeElement(0, 0));
+        assert(!store->destroy(placedHandle));
+        owner.clearHistory();
+        assert(!store->destroy(placedHandle));
+        copy = Scheme();
+        assert(store->destroy(placedHandle) && store->size() == 1);
+
+        owner.checkpoint();
+        assert(owner.removeElement(0, 0) && !store->destroy(turnedHandle));
+        Scheme empty;
+        owner.swap(empty);
+        assert(!store->destroy(turnedHandle));
+        empty = Scheme();
+        assert(store->destroy(turnedHandle) && store->size() == 0);
+    }
+
+    // Тип индекса слоев задается при создании схемы
+    Scheme linearScheme(SpatialIndexType::LINEAR);
+    linearScheme.createLayer();
+    assert(linearScheme.getLayer(0)->getIndexType() == SpatialIndexType::LINEAR);
+
+    // Двоичный файл схемы: сохранение и загрузка через отображение в память
+    {
+        std::vector<std::vector<char>> plate = {{'0', '0', '0'}, {'0', '0', '0'}};
+        std::vector<std::vector<char>> shaft = {{'1', ' '}, {'1', '1'}};
+        Scheme saved(SpatialIndexType::LINEAR);
+        saved.createLayer();
+        saved.createLayer();
+        Element* base = saved.getElement(saved.createElement(3, 2, plate));
+        Motor* drive = static_cast<Motor*>(saved.getElement(saved.createMotor(2, 2, shaft, 70, 1)));
+        drive->setStatus(true);
+        assert(saved.addElement(base, 0, 0, 0));
+        assert(saved.addElement(base, 0, 3, 0)); // один элемент в двух местах
+        assert(saved.addElement(drive, 1, 1, 0));
+
+        const std::string path = "scheme_test.bin";
+        assert(saveScheme(saved, path));
+
+        Scheme loaded;
+        std::string error;
+        assert(loadScheme(path, loaded, &error));
+        assert(!loaded.canUndo() && !loaded.canRedo());
+        assert(loaded.getIndexType() == SpatialIndexType::LINEAR);
+        assert(loaded.getLayerCount() == 2);
+        assert(loaded.getLayer(0)->getElements().size() == 2);
+        assert(loaded.getLayer(0)->getElements()[0].first == loaded.getLayer(0)->getElements()[1].first);
+        for (int y = 0; y < 2; y++) {
+            for (int x = 0; x < 6; x++) {
+                assert(loaded.getLayer(0)->getCell(x, y) == saved.getLayer(0)->getCell(x, y));
+                assert(loaded.getLayer(1)->getCell(x, y) == saved.getLayer(1)->getCell(x, y));
+            }
+        }
+        const Element* loadedDrive = loaded.getLayer(1)->getElements()[0].first;
+        assert(loadedDrive->getType() == ElementType::MOTOR);
+        assert(static_cast<const Motor*>(loadedDrive)->getSpeed() == 70);
+        assert(static_cast<const Motor*>(loadedDrive)->getDirection() == 1);
+        assert(static_cast<const Motor*>(loadedDrive)->getStatus());
+        // Форма совпадает с уже известной, поэтому берется из реестра
+        assert(loadedDrive->hasSameShape(*drive));
+        assert(loaded.validateStructure() == saved.validateStructure());
+
+        // Неизвестная форма смотрит прямо в отображенный файл
+        std::vector<std::vector<char>> odd = {{'1', ' ', '1'}, {'1', '0', '1'}, {' ', '1', ' '}};
+        Scheme single;
+        single.createLayer();
+        Element* oddElem = single.getElement(single.createElement(3, 3, odd));
+        assert(single.addElement(oddElem, 0, 0, 0));
+        assert(saveScheme(single, path));
+        single = Scheme(); // форма больше никем не используется
+        Scheme mapped;
+        assert(loadScheme(path, mapped));
+        const Element* mappedElem = mapped.getLayer(0)->getElements()[0].first;
+        assert(mappedElem->getShape().isMapped());
+        assert(mappedElem->getCell(1, 1) == '0' && mappedElem->getCell(1, 0) == ' ');
+        std::remove(path.c_str());
+
+        // Испорченный файл не меняет схему
+        {
+            std::ofstream junk(path, std::ios::binary);
+            junk << "NOTASCHEME-------------------------------------------------";
+        }
+        assert(!loadScheme(path, mapped, &error));
+        assert(mapped.getLayerCount() == 1);
+        assert(!loadScheme("missing_scheme.bin", mapped));
+
+        // Недопустимые координаты размещения и состояние мотора
+        assert(saveScheme(saved, path));
+        std::string original;
+        {
+            std::ifstream in(path, std::ios::binary);
+            original.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        auto readU64 = [&original](std::size_t at) {
+            std::size_t value = 0;
+            for (int i = 7; i >= 0; i--) {
+                value = (value << 8) | static_cast<unsigned char>(original[at + i]);
+            }
+            return value;
+        };
+        std::size_t shapeTable = readU64(32);
+        std::size_t elementTable = readU64(40);
+        auto loadPatched = [&](std::size_t at, std::uint32_t value) {
+            std::string bytes = original;
+            for (int i = 0; i < 4; i++) {
+                bytes[at + i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+            {
+                std::ofstream out(path, std::ios::binary | std::ios::trunc);
+                out.write(bytes.data(), bytes.size());
+            }
+            std::string message;
+            assert(!loadScheme(path, mapped, &message));
+            return message;
+        };
+        const std::size_t firstPlacement = 48 + 4; // заголовок, число размещений слоя 0
+        const std::size_t motorEntry = elementTable + 16; // мотор - второй элемент
+        assert(loadPatched(firstPlacement + 4, 0x7FFFFFFF) == "corrupt placement");
+        assert(loadPatched(firstPlacement + 8, 0x80000000) == "corrupt placement");
+        assert(loadPatched(motorEntry + 8, 101) == "corrupt element table");
+        assert(loadPatched(motorEntry + 12, 3) == "corrupt element table");
+        // Матрицы форм: plate 3x2 - первая форма, shaft 2x2 - вторая
+        std::size_t platePlanes = readU64(shapeTable + 8);
+        std::size_t shaftPlanes = readU64(shapeTable + 16 + 8);
+        assert(loadPatched(platePlanes, 0xF) == "corrupt shape table");          // бит за шириной
+        assert(loadPatched(platePlanes, 0x3) == "corrupt shape table");          // гнезда не совпадают
+        assert(loadPatched(shaftPlanes + 8 * 2, 0x3) == "corrupt shape table");  // соединитель в пустой клетке
+        assert(mapped.getLayerCount() == 1);
+        std::remove(path.c_str());
+    }
+
+    // Пакетный режим
+    {
+        Scheme batchScheme;
+        std::ostringstream batchOut, batchErr;
+        BatchRunner runner(batchScheme, batchOut, batchErr);
+        std::istringstream script(
+            "# основание и мотор\n"
+            "element base 3 2 000 000\n"
+            "motor drive 2 2 40 1 1. 11\r\n"
+            "layer 2\n"
+            "place base 0 0 0\n"
+            "place drive 1 1 0   # встает на гнезда base\n"
+            "place base 0 2 0\n"   // пересекает первое основание
+            "place ghost 0 9 9\n"
+            "\n"
+            "validate\n"
+            "remove 1 5\n"
+            "bogus");
+        assert(runner.run(script) == 4);
+        assert(runner.getLineNumber() == 12);
+        assert(batchScheme.getLayer(0)->getElements().size() == 1);
+        assert(batchScheme.getLayer(1)->getElements().size() == 1);
+        assert(batchScheme.getLayer(1)->getElements()[0].first->getType() == ElementType::MOTOR);
+        assert(batchOut.str() == "valid\n");
+        const std::string errors = batchErr.str();
+        assert(errors.find("line 7: cannot place 'base'") != std::string::npos);
+        assert(errors.find("line 8: unknown element 'ghost'") != std::string::npos);
+        assert(errors.find("line 11: no element 5 on layer 1") != std::string::npos);
+        assert(errors.find("line 12: unknown command 'bogus'") != std::string::npos);
+
+        // Ошибки разбора не создают элементов
+        std::istringstream badScript("element bad 2 2 00\nmotor m 1 1 500 0 1\nlayer x\nplace\n");
+        assert(runner.run(badScript) == 4);
+        assert(batchScheme.getLayerCount() == 2);
+
+        // Координаты вне допустимых отклоняются до постановки в пачку
+        std::istringstream farScript("place base 0 2147483647 0\nplace base 0 -2000000000 5\n");
+        assert(runner.run(farScript) == 2);
+        assert(batchErr.str().find("position (2147483647, 0) is out of range") != std::string::npos);
+        assert(batchErr.str().find("position (-2000000000, 5) is out of range") != std::string::npos);
+        assert(batchScheme.getLayer(0)->getElements().size() == 1);
+
+        // Номер слоя проверяется при разборе; вывод схемы идет в поток раннера
+        batchOut.str("");
+        std::istringstream outputScript("place base 2 0 0\nplace base -1 0 0\ndisplay\nstats\n");
+        assert(runner.run(outputScript) == 2);
+        assert(batchErr.str().find("line 19: layer 2 doesn't exist") != std::string::npos);
+        assert(batchErr.str().find("line 20: layer -1 doesn't exist") != std::string::npos);
+        std::string expectedFrame;
+        batchScheme.render(expectedFrame);
+        const std::string printed = batchOut.str();
+        assert(printed.compare(0, expectedFrame.size(), expectedFrame) == 0);
+        assert(printed.find("=== SCHEME STATISTICS ===\nTotal layers: 2\n") == expectedFrame.size());
+    }
+
 
     // ТЕСТИРОВАНИЕ КОНСОЛЬНОГО ИНТЕРФЕЙСА
     std::cout << "TESTING CONSOLE INTERFACE..." << std::endl;
@@ -645,25 +1926,27 @@ void runTests()
 
     std::cout << "\nAll tests have been passed!" << std::endl;
 }
-void manageElements(vector<Element*> &elements) {
+void manageElements(vector<Element*> &elements, ElementStore &store) {
     while (true) {
         std::cout << "=== ELEMENT MANAGER ===" << std::endl;
         std::cout << "1. Make element" << std::endl;
         std::cout << "2. Make motor" << std::endl;
         std::cout << "3. Show all elements" << std::endl;
         std::cout << "4. Change element" << std::endl;
-        std::cout << "5. Back to Main Menu" << std::endl;
+        std::cout << "5. Control all motors" << std::endl;
+        std::cout << "6. Back to Main Menu" << std::endl;
         std::cout << "Choose: ";
         int subChoice = getInput();
                 
-        if (subChoice == 1) makeElem(elements);
-        else if (subChoice == 2) makeMotor(elements);
+        if (subChoice == 1) makeElem(elements, store);
+        else if (subChoice == 2) makeMotor(elements, store);
         else if (subChoice == 3) showElements(elements);
         else if (subChoice == 4) {
             showElements(elements);
             controlMotor(elements);
         }
-        else if (subChoice == 5) break;
+        else if (subChoice == 5) controlAllMotors(store.getMotors());
+        else if (subChoice == 6) break;
         else std::cout << "Invalid choice!" << std::endl;
     }
 }
@@ -819,7 +2102,7 @@ void mainMenu() {
         
         if (ans == 1) {
             // Старое меню управления элементами
-            manageElements(elements);
+            manageElements(elements, *scheme.getElementStore());
         }
         else if (ans == 2) {
             schemeMenu(elements, scheme);
@@ -836,11 +2119,35 @@ void mainMenu() {
     }
 }
 
-int main()
+// Пакетный режим: program --batch файл (или "-" для стандартного ввода)
+int runBatch(const std::string& path) {
+    std::ios::sync_with_stdio(false);
+    Scheme scheme;
+    BatchRunner runner(scheme, std::cout, std::cerr);
+    int errors;
+    if (path == "-") {
+        errors = runner.run(std::cin);
+    } else {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error: cannot open " << path << std::endl;
+            return 1;
+        }
+        errors = runner.run(file);
+    }
+    return errors == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
 {
 #ifdef RUN_TESTS
     runTests();
 #else
+    if (argc >= 2 && std::string(argv[1]) == "--batch") {
+        return runBatch(argc >= 3 ? argv[2] : "-");
+    }
+    ConsoleDiagnosticSink console;
+    ScopedDiagnosticSink attachConsole(console);
     mainMenu();
 #endif
 
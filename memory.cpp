@@ -0,0 +1,48 @@
+// memory.cpp
+#include "memory.h"
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#ifdef _WIN32
+    #include <windows.h>
+    #include <psapi.h>
+    #pragma comment(lib, "psapi.lib")
+#else
+    #include <sys/resource.h>
+#endif
+
+ProcessMemory readProcessMemory() {
+    ProcessMemory memory = {false, 0, 0};
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) {
+        memory.available = true;
+        memory.residentKb = pmc.WorkingSetSize / 1024;
+        memory.peakKb = pmc.PeakWorkingSetSize / 1024;
+    }
+#else
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        // Строки вида "VmRSS:     1234 kB"
+        if (line.compare(0, 6, "VmRSS:") == 0) {
+            memory.residentKb = std::strtoul(line.c_str() + 6, nullptr, 10);
+            memory.available = true;
+        } else if (line.compare(0, 6, "VmHWM:") == 0) {
+            memory.peakKb = std::strtoul(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    if (memory.peakKb == 0) {
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+            memory.peakKb = usage.ru_maxrss / 1024; // macOS считает в байтах
+#else
+            memory.peakKb = usage.ru_maxrss;
+#endif
+        }
+    }
+#endif
+    return memory;
+}
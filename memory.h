@@ -0,0 +1,18 @@
+// memory.h
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+
+// Память процесса по данным ОС, в килобайтах
+struct ProcessMemory {
+    bool available;         // ОС сообщила текущий объем
+    std::size_t residentKb; // занято сейчас (RSS / рабочий набор)
+    std::size_t peakKb;     // максимум за время работы
+};
+
+// Linux: VmRSS и VmHWM из /proc/self/status; Windows: psapi;
+// на остальных системах известен только пик (getrusage)
+ProcessMemory readProcessMemory();
+
+#endif // MEMORY_H
@@ -0,0 +1,125 @@
+// metrics.cpp
+#include "metrics.h"
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Блоки всех потоков; блоки завершившихся потоков остаются в сумме
+static std::mutex registryMutex;
+static std::vector<std::unique_ptr<metrics::ThreadBlock>>& registry() {
+    static std::vector<std::unique_ptr<metrics::ThreadBlock>> blocks;
+    return blocks;
+}
+
+static void zeroBlock(metrics::ThreadBlock& block) {
+    for (auto& counter : block.counters) counter.store(0, std::memory_order_relaxed);
+    for (int t = 0; t < METRIC_TIMER_COUNT; t++) {
+        block.timerCounts[t].store(0, std::memory_order_relaxed);
+        block.timerTotals[t].store(0, std::memory_order_relaxed);
+        for (auto& bucket : block.buckets[t]) bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+metrics::ThreadBlock& metrics::threadBlock() {
+    thread_local ThreadBlock* block = nullptr;
+    if (!block) {
+        std::unique_ptr<ThreadBlock> created(new ThreadBlock);
+        zeroBlock(*created);
+        block = created.get();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry().push_back(std::move(created));
+    }
+    return *block;
+}
+
+void metrics::record(MetricTimer timer, std::uint64_t ns) {
+    ThreadBlock& block = threadBlock();
+    int t = static_cast<int>(timer);
+    int bucket = HISTOGRAM_BUCKETS - 1 - __builtin_clzll(ns | 1);
+    bump(block.timerCounts[t], 1);
+    bump(block.timerTotals[t], ns);
+    bump(block.buckets[t][bucket], 1);
+}
+
+MetricsSnapshot getMetrics() {
+    MetricsSnapshot snapshot = {};
+#ifdef CONSTRUCTOR_METRICS
+    snapshot.enabled = true;
+#endif
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& block : registry()) {
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+            snapshot.counters[c] += block->counters[c].load(std::memory_order_relaxed);
+        }
+        for (int t = 0; t < METRIC_TIMER_COUNT; t++) {
+            LatencyHistogram& histogram = snapshot.timers[t];
+            histogram.count += block->timerCounts[t].load(std::memory_order_relaxed);
+            histogram.totalNs += block->timerTotals[t].load(std::memory_order_relaxed);
+            for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+                histogram.buckets[b] += block->buckets[t][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return snapshot;
+}
+
+void resetMetrics() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& block : registry()) {
+        zeroBlock(*block);
+    }
+}
+
+double LatencyHistogram::meanNs() const {
+    return count ? static_cast<double>(totalNs) / count : 0.0;
+}
+
+std::uint64_t LatencyHistogram::percentileNs(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    std::uint64_t target = static_cast<std::uint64_t>(fraction * count);
+    std::uint64_t seen = 0;
+    for (int b = 0; b < HISTOGRAM_BUCKETS; b++) {
+        seen += buckets[b];
+        if (seen > target || seen == count) {
+            return b + 1 < HISTOGRAM_BUCKETS ? (std::uint64_t(1) << (b + 1)) : UINT64_MAX;
+        }
+    }
+    return UINT64_MAX;
+}
+
+std::uint64_t MetricsSnapshot::get(MetricCounter counter) const {
+    return counters[static_cast<int>(counter)];
+}
+
+const LatencyHistogram& MetricsSnapshot::get(MetricTimer timer) const {
+    return timers[static_cast<int>(timer)];
+}
+
+const char* getMetricName(MetricCounter counter) {
+    switch (counter) {
+        case MetricCounter::OVERLAP_CALLS: return "hasOverlap calls";
+        case MetricCounter::OVERLAP_SCANNED: return "hasOverlap elements scanned";
+        case MetricCounter::GET_CELL_CALLS: return "getCell calls";
+        case MetricCounter::CONNECTION_CHECKS: return "connection checks";
+        case MetricCounter::CELLS_COMPARED: return "connection cells compared";
+        case MetricCounter::PLACEMENTS_ACCEPTED: return "placements accepted";
+        case MetricCounter::REJECTED_INVALID_LAYER: return "rejected: invalid layer";
+        case MetricCounter::REJECTED_INVALID_ELEMENT: return "rejected: invalid element";
+        case MetricCounter::REJECTED_OVERLAP: return "rejected: overlap";
+        case MetricCounter::REJECTED_OUT_OF_RANGE: return "rejected: coordinates out of range";
+        case MetricCounter::REJECTED_NO_CONNECTION: return "rejected: no connection";
+        case MetricCounter::REJECTED_ROLLED_BACK: return "rejected: batch rolled back";
+        default: return "?";
+    }
+}
+
+const char* getMetricName(MetricTimer timer) {
+    switch (timer) {
+        case MetricTimer::ADD_ELEMENT: return "addElement";
+        case MetricTimer::REMOVE_ELEMENT: return "removeElement";
+        case MetricTimer::VALIDATE_STRUCTURE: return "validateStructure";
+        default: return "?";
+    }
+}
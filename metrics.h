@@ -0,0 +1,120 @@
+// metrics.h
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Встроенные счетчики горячих путей и гистограммы задержек.
+// Собираются только при сборке с -DCONSTRUCTOR_METRICS, иначе макросы
+// METRIC_* пусты и ничего не стоят. Каждый поток пишет в свой блок
+// счетчиков, блоки суммируются при чтении (getMetrics).
+
+enum class MetricCounter
+{
+    OVERLAP_CALLS,        // Layer::hasOverlap
+    OVERLAP_SCANNED,      // элементы индекса, проверенные на пересечение
+    GET_CELL_CALLS,       // Layer::getCell
+    CONNECTION_CHECKS,    // проверки соединения с нижним слоем
+    CELLS_COMPARED,       // клетки, сравненные при этих проверках
+    PLACEMENTS_ACCEPTED,
+    REJECTED_INVALID_LAYER,
+    REJECTED_INVALID_ELEMENT,
+    REJECTED_OVERLAP,
+    REJECTED_OUT_OF_RANGE,
+    REJECTED_NO_CONNECTION,
+    REJECTED_ROLLED_BACK,
+    COUNT,
+};
+
+enum class MetricTimer
+{
+    ADD_ELEMENT,
+    REMOVE_ELEMENT,
+    VALIDATE_STRUCTURE,
+    COUNT,
+};
+
+const int METRIC_COUNTER_COUNT = static_cast<int>(MetricCounter::COUNT);
+const int METRIC_TIMER_COUNT = static_cast<int>(MetricTimer::COUNT);
+// Корзина i гистограммы - длительности [2^i, 2^(i+1)) наносекунд
+const int HISTOGRAM_BUCKETS = 64;
+
+struct LatencyHistogram {
+    std::uint64_t count;
+    std::uint64_t totalNs;
+    std::uint64_t buckets[HISTOGRAM_BUCKETS];
+
+    double meanNs() const;
+    // Верхняя граница корзины, в которую попадает доля fraction замеров
+    std::uint64_t percentileNs(double fraction) const;
+};
+
+struct MetricsSnapshot {
+    bool enabled; // программа собрана с CONSTRUCTOR_METRICS
+    std::uint64_t counters[METRIC_COUNTER_COUNT];
+    LatencyHistogram timers[METRIC_TIMER_COUNT];
+
+    std::uint64_t get(MetricCounter counter) const;
+    const LatencyHistogram& get(MetricTimer timer) const;
+};
+
+const char* getMetricName(MetricCounter counter);
+const char* getMetricName(MetricTimer timer);
+
+// Сумма по всем потокам с начала работы (или с resetMetrics)
+MetricsSnapshot getMetrics();
+// Обнуляет счетчики; замеры, идущие в этот момент, могут частично уцелеть
+void resetMetrics();
+
+namespace metrics {
+
+// Блок счетчиков одного потока: пишет только владелец,
+// поэтому хватает relaxed-чтения и записи без блокировок шины
+struct ThreadBlock {
+    std::atomic<std::uint64_t> counters[METRIC_COUNTER_COUNT];
+    std::atomic<std::uint64_t> timerCounts[METRIC_TIMER_COUNT];
+    std::atomic<std::uint64_t> timerTotals[METRIC_TIMER_COUNT];
+    std::atomic<std::uint64_t> buckets[METRIC_TIMER_COUNT][HISTOGRAM_BUCKETS];
+};
+
+ThreadBlock& threadBlock();
+
+inline void bump(std::atomic<std::uint64_t>& value, std::uint64_t amount) {
+    value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+inline void add(MetricCounter counter, std::uint64_t amount) {
+    bump(threadBlock().counters[static_cast<int>(counter)], amount);
+}
+
+void record(MetricTimer timer, std::uint64_t ns);
+
+// Замер длительности области видимости
+class ScopedTimer {
+private:
+    MetricTimer timer;
+    std::chrono::steady_clock::time_point started;
+
+public:
+    explicit ScopedTimer(MetricTimer measured)
+        : timer(measured), started(std::chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        auto elapsed = std::chrono::steady_clock::now() - started;
+        record(timer, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+} // namespace metrics
+
+#ifdef CONSTRUCTOR_METRICS
+    #define METRIC_ADD(counter, amount) metrics::add(MetricCounter::counter, (amount))
+    #define METRIC_TIMER(timer) metrics::ScopedTimer metricTimer(MetricTimer::timer)
+#else
+    #define METRIC_ADD(counter, amount) ((void)0)
+    #define METRIC_TIMER(timer) ((void)0)
+#endif
+
+#endif // METRICS_H
@@ -0,0 +1,138 @@
+// motorregistry.cpp
+#include "motorregistry.h"
+#include "element.h"
+#include <algorithm>
+
+MotorRegistry::MotorRegistry() : liveCount(0) {}
+
+void MotorRegistry::attach(std::uint32_t slot, Motor* motor) {
+    if (slot >= speeds.size()) {
+        speeds.resize(slot + 1, 0);
+        directions.resize(slot + 1, 0);
+        running.resize(slot + 1, 0);
+        live.resize(slot + 1, 0);
+        views.resize(slot + 1, nullptr);
+    }
+    if (live[slot]) {
+        detach(slot);
+    }
+    speeds[slot] = motor->speed;
+    directions[slot] = static_cast<std::int8_t>(motor->direction);
+    running[slot] = motor->isRotating ? 1 : 0;
+    live[slot] = 1;
+    views[slot] = motor;
+    motor->registry = this;
+    motor->slot = slot;
+    liveCount++;
+}
+
+void MotorRegistry::detach(std::uint32_t slot) {
+    if (!contains(slot)) {
+        return;
+    }
+    Motor* motor = views[slot];
+    motor->speed = speeds[slot];
+    motor->direction = directions[slot];
+    motor->isRotating = running[slot] != 0;
+    motor->registry = nullptr;
+    speeds[slot] = 0;
+    directions[slot] = 0;
+    running[slot] = 0;
+    live[slot] = 0;
+    views[slot] = nullptr;
+    liveCount--;
+}
+
+void MotorRegistry::clear() {
+    for (std::uint32_t slot = 0; slot < getSlotCount(); slot++) {
+        detach(slot);
+    }
+}
+
+std::size_t MotorRegistry::size() const {
+    return liveCount;
+}
+
+std::uint32_t MotorRegistry::getSlotCount() const {
+    return static_cast<std::uint32_t>(speeds.size());
+}
+
+bool MotorRegistry::contains(std::uint32_t slot) const {
+    return slot < live.size() && live[slot];
+}
+
+Motor* MotorRegistry::getMotor(std::uint32_t slot) const {
+    return slot < views.size() ? views[slot] : nullptr;
+}
+
+int MotorRegistry::getSpeed(std::uint32_t slot) const {
+    return slot < speeds.size() ? speeds[slot] : 0;
+}
+
+int MotorRegistry::getDirection(std::uint32_t slot) const {
+    return slot < directions.size() ? directions[slot] : 0;
+}
+
+bool MotorRegistry::getStatus(std::uint32_t slot) const {
+    return slot < running.size() && running[slot];
+}
+
+// Пустые ячейки и так нулевые, поэтому заполняются целиком
+void MotorRegistry::stopAll() {
+    std::fill(speeds.begin(), speeds.end(), 0);
+    std::fill(directions.begin(), directions.end(), 0);
+    std::fill(running.begin(), running.end(), 0);
+}
+
+bool MotorRegistry::scaleSpeeds(float factor) {
+    if (!(factor >= 0.0f)) {
+        return false;
+    }
+    // Множитель в фиксированной точке 16.16: цикл целочисленный и векторизуется.
+    // Больше 100 не нужно - любая ненулевая скорость все равно станет 100
+    const std::int32_t ONE = 1 << 16;
+    std::int32_t scale = static_cast<std::int32_t>(std::min(factor, 100.0f) * ONE + 0.5f);
+    std::size_t count = speeds.size();
+    std::int32_t* speed = speeds.data();
+    for (std::size_t i = 0; i < count; i++) {
+        std::int32_t value = (speed[i] * scale + ONE / 2) >> 16;
+        speed[i] = value < 100 ? value : 100;
+    }
+    return true;
+}
+
+bool MotorRegistry::setDirection(const std::vector<std::uint32_t>& slots, int direction) {
+    if (direction != 0 && direction != 1 && direction != 2) {
+        return false;
+    }
+    for (std::uint32_t slot : slots) {
+        if (contains(slot)) {
+            directions[slot] = static_cast<std::int8_t>(direction);
+        }
+    }
+    return true;
+}
+
+std::size_t MotorRegistry::countRunning() const {
+    std::uint32_t count = 0;
+    std::size_t slots = running.size();
+    const std::uint8_t* isRunning = running.data();
+    for (std::size_t i = 0; i < slots; i++) {
+        count += isRunning[i];
+    }
+    return count;
+}
+
+void MotorRegistry::getRunning(std::vector<std::uint32_t>& out) const {
+    out.clear();
+    for (std::uint32_t slot = 0; slot < getSlotCount(); slot++) {
+        if (running[slot]) {
+            out.push_back(slot);
+        }
+    }
+}
+
+std::size_t MotorRegistry::getMemoryUsage() const {
+    return speeds.capacity() * sizeof(std::int32_t) + directions.capacity() * sizeof(std::int8_t) +
+           running.capacity() + live.capacity() + views.capacity() * sizeof(Motor*);
+}
@@ -0,0 +1,87 @@
+// motorregistry.h
+#ifndef MOTORREGISTRY_H
+#define MOTORREGISTRY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Motor;
+
+// Состояние моторов хранилища в отдельных массивах: номер мотора - номер
+// его ячейки в пуле (PoolHandle::index). Объект Motor, прикрепленный к
+// реестру, читает и пишет свое состояние здесь, поэтому групповые команды
+// - один проход по массивам без обращения к самим моторам.
+class MotorRegistry {
+private:
+    std::vector<std::int32_t> speeds;    // 0..100
+    std::vector<std::int8_t> directions; // 0 - нет, 1 - по часовой, 2 - против
+    std::vector<std::uint8_t> running;
+    std::vector<std::uint8_t> live;      // в ячейке есть мотор
+    std::vector<Motor*> views;
+    std::size_t liveCount;
+
+    // Прикрепляет и открепляет моторы только хранилище: при создании
+    // мотора (до появления его повернутых копий) и перед его удалением
+    friend class Motor;
+    friend class ElementStore;
+
+    // Мотор переносит свое состояние в ячейку slot и дальше работает с ней
+    void attach(std::uint32_t slot, Motor* motor);
+    // Мотор получает состояние обратно, ячейка обнуляется
+    void detach(std::uint32_t slot);
+    void clear();
+
+public:
+    MotorRegistry();
+    MotorRegistry(const MotorRegistry&) = delete;
+    MotorRegistry& operator=(const MotorRegistry&) = delete;
+
+    std::size_t size() const;          // прикрепленных моторов
+    std::uint32_t getSlotCount() const; // длина массивов
+    bool contains(std::uint32_t slot) const;
+    Motor* getMotor(std::uint32_t slot) const; // nullptr для пустой ячейки
+    int getSpeed(std::uint32_t slot) const;
+    int getDirection(std::uint32_t slot) const;
+    bool getStatus(std::uint32_t slot) const;
+
+    // Групповые команды (пустые ячейки не затрагиваются)
+    void stopAll(); // как Motor::stop для каждого
+    // Скорости умножаются на factor с округлением и ограничением 0..100;
+    // состояние вращения не меняется, как у Motor::setSpeed
+    bool scaleSpeeds(float factor);
+    // Направление моторам, для которых pred(speed, direction, running) истинно;
+    // возвращает их число, 0 при неверном направлении
+    template <typename Predicate>
+    std::size_t setDirectionWhere(Predicate pred, int direction);
+    // Направление моторам из списка ячеек; false при неверном направлении
+    bool setDirection(const std::vector<std::uint32_t>& slots, int direction);
+
+    // Запросы
+    std::size_t countRunning() const;
+    void getRunning(std::vector<std::uint32_t>& out) const; // по возрастанию
+    std::size_t getMemoryUsage() const;
+};
+
+template <typename Predicate>
+std::size_t MotorRegistry::setDirectionWhere(Predicate pred, int direction) {
+    if (direction != 0 && direction != 1 && direction != 2) {
+        return 0;
+    }
+    std::int8_t value = static_cast<std::int8_t>(direction);
+    std::size_t matched = 0;
+    std::size_t count = speeds.size();
+    const std::int32_t* speed = speeds.data();
+    const std::uint8_t* isRunning = running.data();
+    const std::uint8_t* isLive = live.data();
+    std::int8_t* dir = directions.data();
+    // Выбор вместо ветвления: при простом предикате цикл векторизуется
+    for (std::size_t i = 0; i < count; i++) {
+        bool hit = (isLive[i] != 0) & pred(speed[i], static_cast<int>(dir[i]), isRunning[i] != 0);
+        dir[i] = hit ? value : dir[i];
+        matched += hit;
+    }
+    return matched;
+}
+
+#endif // MOTORREGISTRY_H
@@ -0,0 +1,91 @@
+// pool.cpp
+#include "pool.h"
+#include "scheme.h"
+#include <algorithm>
+
+ElementStore::ElementStore() {}
+
+ElementHandle ElementStore::createElement(int w, int h, const std::vector<std::vector<char>>& mat) {
+    return ElementHandle{elements.create(w, h, mat), ElementType::ELEMENT};
+}
+
+ElementHandle ElementStore::createMotor(int w, int h, const std::vector<std::vector<char>>& mat,
+                                        int spd, int dir) {
+    PoolHandle handle = motors.create(w, h, mat, spd, dir);
+    motorRegistry.attach(handle.index, motors.get(handle));
+    return ElementHandle{handle, ElementType::MOTOR};
+}
+
+ElementHandle ElementStore::createElement(const std::shared_ptr<const Shape>& shape) {
+    return ElementHandle{elements.create(shape), ElementType::ELEMENT};
+}
+
+ElementHandle ElementStore::createMotor(const std::shared_ptr<const Shape>& shape, int spd, int dir) {
+    PoolHandle handle = motors.create(shape, spd, dir);
+    motorRegistry.attach(handle.index, motors.get(handle));
+    return ElementHandle{handle, ElementType::MOTOR};
+}
+
+Element* ElementStore::get(ElementHandle handle) const {
+    if (handle.type == ElementType::MOTOR) {
+        return motors.get(handle.handle);
+    }
+    return elements.get(handle.handle);
+}
+
+MotorRegistry& ElementStore::getMotors() {
+    return motorRegistry;
+}
+
+const MotorRegistry& ElementStore::getMotors() const {
+    return motorRegistry;
+}
+
+void ElementStore::attachUser(const Scheme* scheme) {
+    std::lock_guard<std::mutex> lock(usersMutex);
+    users.push_back(scheme);
+}
+
+void ElementStore::detachUser(const Scheme* scheme) {
+    std::lock_guard<std::mutex> lock(usersMutex);
+    auto it = std::find(users.begin(), users.end(), scheme);
+    if (it != users.end()) {
+        users.erase(it);
+    }
+}
+
+bool ElementStore::isInUse(const Element* elem) const {
+    std::lock_guard<std::mutex> lock(usersMutex);
+    for (const Scheme* scheme : users) {
+        if (scheme->referencesElement(elem)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ElementStore::destroy(ElementHandle handle) {
+    Element* elem = get(handle);
+    if (!elem || isInUse(elem)) {
+        return false;
+    }
+    if (handle.type == ElementType::MOTOR) {
+        motorRegistry.detach(handle.handle.index);
+        return motors.destroy(handle.handle);
+    }
+    return elements.destroy(handle.handle);
+}
+
+void ElementStore::clear() {
+    motorRegistry.clear();
+    elements.clear();
+    motors.clear();
+}
+
+std::size_t ElementStore::getMemoryUsage() const {
+    return elements.getMemoryUsage() + motors.getMemoryUsage() + motorRegistry.getMemoryUsage();
+}
+
+std::size_t ElementStore::size() const {
+    return elements.size() + motors.size();
+}
@@ -0,0 +1,221 @@
+// pool.h
+#ifndef POOL_H
+#define POOL_H
+
+#include "element.h"
+#include "motorregistry.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Устойчивый дескриптор объекта пула: номер ячейки и ее поколение.
+// После удаления объекта старый дескриптор перестает быть действительным.
+struct PoolHandle {
+    std::uint32_t index;
+    std::uint32_t generation;
+
+    bool operator==(const PoolHandle& other) const {
+        return index == other.index && generation == other.generation;
+    }
+    bool operator!=(const PoolHandle& other) const { return !(*this == other); }
+};
+
+const PoolHandle INVALID_POOL_HANDLE = {0xFFFFFFFFu, 0};
+
+// Типизированный пул: объекты лежат в блоках по CHUNK_SIZE ячеек, адреса
+// не меняются, освободившиеся ячейки используются повторно, а все объекты
+// освобождаются разом при уничтожении пула.
+template <typename T>
+class ObjectPool {
+private:
+    static const std::size_t CHUNK_SIZE = 64;
+
+    struct Slot {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::uint32_t generation;
+        bool alive;
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> chunks;
+    std::vector<std::uint32_t> freeSlots;
+    std::uint32_t slotCount;
+    std::size_t liveCount;
+
+    Slot* slotAt(std::uint32_t index) const {
+        return &chunks[index / CHUNK_SIZE][index % CHUNK_SIZE];
+    }
+
+    static T* objectIn(Slot* slot) {
+        return reinterpret_cast<T*>(slot->storage);
+    }
+
+    std::uint32_t takeSlot() {
+        if (!freeSlots.empty()) {
+            std::uint32_t index = freeSlots.back();
+            freeSlots.pop_back();
+            return index;
+        }
+        if (slotCount % CHUNK_SIZE == 0) {
+            std::unique_ptr<Slot[]> chunk(new Slot[CHUNK_SIZE]);
+            for (std::size_t i = 0; i < CHUNK_SIZE; i++) {
+                chunk[i].generation = 0;
+                chunk[i].alive = false;
+            }
+            chunks.push_back(std::move(chunk));
+        }
+        return slotCount++;
+    }
+
+public:
+    ObjectPool() : slotCount(0), liveCount(0) {}
+
+    // Копия хранит объекты в тех же ячейках: дескрипторы оригинала
+    // действительны и для копии
+    ObjectPool(const ObjectPool& other) : slotCount(0), liveCount(0) {
+        while (slotCount < other.slotCount) {
+            takeSlot();
+        }
+        for (std::uint32_t i = 0; i < slotCount; i++) {
+            Slot* source = other.slotAt(i);
+            Slot* target = slotAt(i);
+            target->generation = source->generation;
+            if (source->alive) {
+                new (target->storage) T(*objectIn(source));
+                target->alive = true;
+                liveCount++;
+            }
+        }
+        freeSlots = other.freeSlots;
+    }
+
+    ObjectPool& operator=(const ObjectPool& other) {
+        if (this != &other) {
+            ObjectPool copy(other);
+            swap(copy);
+        }
+        return *this;
+    }
+
+    ~ObjectPool() {
+        clear();
+    }
+
+    void swap(ObjectPool& other) {
+        chunks.swap(other.chunks);
+        freeSlots.swap(other.freeSlots);
+        std::swap(slotCount, other.slotCount);
+        std::swap(liveCount, other.liveCount);
+    }
+
+    template <typename... Args>
+    PoolHandle create(Args&&... args) {
+        std::uint32_t index = takeSlot();
+        Slot* slot = slotAt(index);
+        new (slot->storage) T(std::forward<Args>(args)...);
+        slot->alive = true;
+        liveCount++;
+        return PoolHandle{index, slot->generation};
+    }
+
+    bool destroy(PoolHandle handle) {
+        T* object = get(handle);
+        if (!object) {
+            return false;
+        }
+        Slot* slot = slotAt(handle.index);
+        object->~T();
+        slot->alive = false;
+        slot->generation++;
+        freeSlots.push_back(handle.index);
+        liveCount--;
+        return true;
+    }
+
+    T* get(PoolHandle handle) const {
+        if (handle.index >= slotCount) {
+            return nullptr;
+        }
+        Slot* slot = slotAt(handle.index);
+        if (!slot->alive || slot->generation != handle.generation) {
+            return nullptr;
+        }
+        return objectIn(slot);
+    }
+
+    // Освобождает все объекты; блоки памяти остаются для повторного использования
+    void clear() {
+        freeSlots.clear();
+        for (std::uint32_t i = 0; i < slotCount; i++) {
+            Slot* slot = slotAt(i);
+            if (slot->alive) {
+                objectIn(slot)->~T();
+                slot->alive = false;
+                slot->generation++;
+            }
+        }
+        for (std::uint32_t i = slotCount; i > 0; i--) {
+            freeSlots.push_back(i - 1);
+        }
+        liveCount = 0;
+    }
+
+    std::size_t size() const { return liveCount; }
+    std::size_t capacity() const { return chunks.size() * CHUNK_SIZE; }
+    std::size_t getMemoryUsage() const {
+        return chunks.size() * CHUNK_SIZE * sizeof(Slot) + chunks.capacity() * sizeof(chunks[0]) +
+               freeSlots.capacity() * sizeof(std::uint32_t);
+    }
+};
+
+class Scheme;
+
+// Дескриптор элемента хранилища: тип определяет пул
+struct ElementHandle {
+    PoolHandle handle;
+    ElementType type;
+};
+
+// Хранилище элементов и моторов. Элементы живут, пока живо хранилище;
+// схема и ее копии владеют им совместно. Состояние моторов хранилища
+// лежит в реестре (номер мотора - индекс его дескриптора).
+// Слои и журнал хранят указатели на элементы, поэтому destroy не удаляет
+// элемент, который еще нужен одной из схем, работающих с хранилищем.
+class ElementStore {
+private:
+    MotorRegistry motorRegistry;
+    ObjectPool<Element> elements;
+    ObjectPool<Motor> motors;
+    std::vector<const Scheme*> users; // схемы, которые могут ссылаться на элементы
+    mutable std::mutex usersMutex;
+
+    friend class Scheme;
+    void attachUser(const Scheme* scheme);
+    void detachUser(const Scheme* scheme);
+    bool isInUse(const Element* elem) const;
+
+public:
+    ElementStore();
+    ElementStore(const ElementStore&) = delete;
+    ElementStore& operator=(const ElementStore&) = delete;
+
+    ElementHandle createElement(int w, int h, const std::vector<std::vector<char>>& mat);
+    ElementHandle createMotor(int w, int h, const std::vector<std::vector<char>>& mat,
+                              int spd = 0, int dir = 0);
+    ElementHandle createElement(const std::shared_ptr<const Shape>& shape);
+    ElementHandle createMotor(const std::shared_ptr<const Shape>& shape, int spd, int dir);
+    Element* get(ElementHandle handle) const;
+    MotorRegistry& getMotors();
+    const MotorRegistry& getMotors() const;
+    // false, если дескриптор недействителен или элемент (его копия) стоит
+    // на слое, записан в истории правок или в точке отката схемы
+    bool destroy(ElementHandle handle);
+    void clear();
+    std::size_t size() const;
+    std::size_t getMemoryUsage() const; // ячейки пулов и реестр моторов (без форм)
+};
+
+#endif // POOL_H
@@ -0,0 +1,205 @@
+// raster.cpp
+#include "raster.h"
+#include <algorithm>
+
+const int LayerRaster::CHUNK;
+const int LayerRaster::NO_OWNER;
+
+// Номер блока клетки (округление вниз). Координаты считаются в long long:
+// x + k * CHUNK у края диапазона int не переполняется
+static long long tileOf(long long value) {
+    const long long chunk = LayerRaster::CHUNK;
+    return (value >= 0) ? value / chunk : -((-value + chunk - 1) / chunk);
+}
+
+// Обходит строки формы с углом (x, y) по блокам: apply получает блок,
+// строку в нем и слова занятости/соединителей, сдвинутые на столбцы блока
+template <typename Apply>
+static void forEachTileWord(const Shape& shape, int x, int y, Apply apply) {
+    const int chunk = LayerRaster::CHUNK;
+    const BitPlane& occupancy = shape.getOccupancy();
+    const BitPlane& connectors = shape.getConnectors();
+    int rowWords = occupancy.getWordsPerRow();
+    for (int i = 0; i < shape.getHeight(); i++) {
+        long long cellY = static_cast<long long>(y) + i;
+        long long tileY = tileOf(cellY);
+        int row = static_cast<int>(cellY - tileY * chunk);
+        const std::uint64_t* occupancyRow = occupancy.getRow(i);
+        const std::uint64_t* connectorRow = connectors.getRow(i);
+        for (int k = 0; k < rowWords; k++) {
+            if (occupancyRow[k] == 0) continue;
+            long long cellX = static_cast<long long>(x) + static_cast<long long>(k) * chunk;
+            long long tileX = tileOf(cellX);
+            int offset = static_cast<int>(cellX - tileX * chunk);
+            // Слово формы ложится на два соседних блока, если offset > 0
+            std::uint64_t low = occupancyRow[k] << offset;
+            if (low != 0) {
+                apply(tileX, tileY, row, low, connectorRow[k] << offset);
+            }
+            if (offset > 0) {
+                std::uint64_t high = occupancyRow[k] >> (chunk - offset);
+                if (high != 0) {
+                    apply(tileX + 1, tileY, row, high, connectorRow[k] >> (chunk - offset));
+                }
+            }
+        }
+    }
+}
+
+// 64 клетки начиная со столбца offset строки блока lowRow
+// (хвост - из той же строки следующего блока highRow)
+static void readWord(const std::uint64_t* lowRow, const std::uint64_t* highRow, int offset,
+                     std::uint64_t& word) {
+    word = lowRow ? (*lowRow >> offset) : 0;
+    if (highRow && offset > 0) {
+        word |= *highRow << (LayerRaster::CHUNK - offset);
+    }
+}
+
+LayerRaster::Tile::Tile() : cellCount(0) {
+    std::fill(occupancy, occupancy + CHUNK, 0);
+    std::fill(connectors, connectors + CHUNK, 0);
+    std::fill(owners, owners + CHUNK * CHUNK, NO_OWNER);
+}
+
+LayerRaster::LayerRaster() {}
+
+LayerRaster::LayerRaster(const LayerRaster& other) : tiles(other.tiles) {}
+
+std::uint64_t LayerRaster::tileKey(long long tileX, long long tileY) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(tileX)) << 32) |
+           static_cast<std::uint32_t>(tileY);
+}
+
+const LayerRaster::Tile* LayerRaster::findTile(long long tileX, long long tileY) const {
+    auto it = tiles.find(tileKey(tileX, tileY));
+    return (it == tiles.end()) ? nullptr : &it->second;
+}
+
+void LayerRaster::paint(int ownerId, const Shape& shape, int x, int y) {
+    forEachTileWord(shape, x, y, [this, ownerId](long long tileX, long long tileY, int row,
+                                                 std::uint64_t occupied, std::uint64_t connected) {
+        Tile& tile = tiles[tileKey(tileX, tileY)];
+        tile.cellCount += __builtin_popcountll(occupied & ~tile.occupancy[row]);
+        tile.occupancy[row] |= occupied;
+        tile.connectors[row] |= connected;
+        int* ownerRow = tile.owners + row * CHUNK;
+        for (std::uint64_t bits = occupied; bits != 0; bits &= bits - 1) {
+            ownerRow[__builtin_ctzll(bits)] = ownerId;
+        }
+    });
+}
+
+void LayerRaster::erase(const Shape& shape, int x, int y) {
+    forEachTileWord(shape, x, y, [this](long long tileX, long long tileY, int row,
+                                        std::uint64_t occupied, std::uint64_t) {
+        auto it = tiles.find(tileKey(tileX, tileY));
+        if (it == tiles.end()) return;
+        Tile& tile = it->second;
+        tile.cellCount -= __builtin_popcountll(occupied & tile.occupancy[row]);
+        tile.occupancy[row] &= ~occupied;
+        tile.connectors[row] &= ~occupied;
+        int* ownerRow = tile.owners + row * CHUNK;
+        for (std::uint64_t bits = occupied; bits != 0; bits &= bits - 1) {
+            ownerRow[__builtin_ctzll(bits)] = NO_OWNER;
+        }
+        if (tile.cellCount == 0) {
+            tiles.erase(it);
+        }
+    });
+}
+
+void LayerRaster::clear() {
+    tiles.clear();
+}
+
+char LayerRaster::getCell(int x, int y) const {
+    long long tileX = tileOf(x);
+    long long tileY = tileOf(y);
+    const Tile* tile = findTile(tileX, tileY);
+    if (!tile) {
+        return ' ';
+    }
+    int column = static_cast<int>(x - tileX * CHUNK);
+    int row = static_cast<int>(y - tileY * CHUNK);
+    std::uint64_t bit = std::uint64_t(1) << column;
+    if (!(tile->occupancy[row] & bit)) {
+        return ' ';
+    }
+    return (tile->connectors[row] & bit) ? '1' : '0';
+}
+
+int LayerRaster::getOwner(int x, int y) const {
+    long long tileX = tileOf(x);
+    long long tileY = tileOf(y);
+    const Tile* tile = findTile(tileX, tileY);
+    if (!tile) {
+        return NO_OWNER;
+    }
+    int column = static_cast<int>(x - tileX * CHUNK);
+    int row = static_cast<int>(y - tileY * CHUNK);
+    return tile->owners[row * CHUNK + column];
+}
+
+void LayerRaster::getRowBits(int x, int y, std::uint64_t& occupied, std::uint64_t& connected) const {
+    long long tileX = tileOf(x);
+    long long tileY = tileOf(y);
+    int offset = static_cast<int>(x - tileX * CHUNK);
+    int row = static_cast<int>(y - tileY * CHUNK);
+    const Tile* low = findTile(tileX, tileY);
+    const Tile* high = offset > 0 ? findTile(tileX + 1, tileY) : nullptr;
+    readWord(low ? &low->occupancy[row] : nullptr, high ? &high->occupancy[row] : nullptr, offset, occupied);
+    readWord(low ? &low->connectors[row] : nullptr, high ? &high->connectors[row] : nullptr, offset, connected);
+}
+
+void LayerRaster::getSocketWindow(int x, int y, int w, int h, std::vector<std::uint64_t>& out) const {
+    int windowWords = (w + CHUNK - 1) / CHUNK;
+    out.assign(static_cast<size_t>(windowWords) * h, 0);
+    if (tiles.empty()) {
+        return;
+    }
+    // По столбцам слов: пара блоков меняется раз в CHUNK строк
+    for (int k = 0; k < windowWords; k++) {
+        long long cellX = static_cast<long long>(x) + static_cast<long long>(k) * CHUNK;
+        long long tileX = tileOf(cellX);
+        int offset = static_cast<int>(cellX - tileX * CHUNK);
+        const Tile* low = nullptr;
+        const Tile* high = nullptr;
+        long long tileY = 0;
+        bool loaded = false;
+        for (int i = 0; i < h; i++) {
+            long long cellY = static_cast<long long>(y) + i;
+            if (!loaded || tileOf(cellY) != tileY) {
+                tileY = tileOf(cellY);
+                low = findTile(tileX, tileY);
+                high = offset > 0 ? findTile(tileX + 1, tileY) : nullptr;
+                loaded = true;
+            }
+            if (!low && !high) continue;
+            int row = static_cast<int>(cellY - tileY * CHUNK);
+            std::uint64_t occupied, connected;
+            readWord(low ? &low->occupancy[row] : nullptr, high ? &high->occupancy[row] : nullptr, offset, occupied);
+            readWord(low ? &low->connectors[row] : nullptr, high ? &high->connectors[row] : nullptr, offset, connected);
+            out[static_cast<size_t>(i) * windowWords + k] = occupied & ~connected;
+        }
+    }
+    if (w % CHUNK != 0) {
+        std::uint64_t tailMask = (std::uint64_t(1) << (w % CHUNK)) - 1;
+        for (int i = 0; i < h; i++) {
+            out[static_cast<size_t>(i + 1) * windowWords - 1] &= tailMask;
+        }
+    }
+}
+
+std::size_t LayerRaster::getTileCount() const {
+    return tiles.size();
+}
+
+std::size_t LayerRaster::getMemoryUsage() const {
+    if (tiles.empty()) {
+        return 0;
+    }
+    // Узел таблицы: ключ, блок и указатель на следующий узел
+    return tiles.bucket_count() * sizeof(void*) +
+           tiles.size() * (sizeof(std::uint64_t) + sizeof(Tile) + sizeof(void*));
+}
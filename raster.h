@@ -0,0 +1,55 @@
+// raster.h
+#ifndef RASTER_H
+#define RASTER_H
+
+#include "shape.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Растр слоя: для каждой клетки хранит id размещения-владельца,
+// а также упакованные маски занятости и соединителей.
+// Хранятся только блоки CHUNK x CHUNK клеток, где что-то стоит, поэтому
+// память зависит от числа занятых блоков, а не от разброса координат.
+class LayerRaster {
+public:
+    static const int CHUNK = 64; // совпадает с длиной слова маски
+    static const int NO_OWNER = -1;
+
+private:
+    struct Tile {
+        std::uint64_t occupancy[CHUNK];  // строка блока - одно слово
+        std::uint64_t connectors[CHUNK];
+        int owners[CHUNK * CHUNK];
+        int cellCount; // занятых клеток; пустой блок удаляется
+
+        Tile();
+    };
+
+    std::unordered_map<std::uint64_t, Tile> tiles;
+
+    static std::uint64_t tileKey(long long tileX, long long tileY);
+    const Tile* findTile(long long tileX, long long tileY) const;
+
+public:
+    LayerRaster(); // Конструктор по умолчанию
+    LayerRaster(const LayerRaster& other); // Конструктор копирования
+
+    // Закрашивает / стирает только клетки, занятые формой
+    void paint(int ownerId, const Shape& shape, int x, int y);
+    void erase(const Shape& shape, int x, int y);
+    void clear();
+
+    char getCell(int x, int y) const;
+    int getOwner(int x, int y) const;
+    // 64 клетки строки y начиная со столбца x: занятость и соединители
+    void getRowBits(int x, int y, std::uint64_t& occupied, std::uint64_t& connected) const;
+    // Гнезда окна, упакованные по строкам (как Layer::getSocketWindow)
+    void getSocketWindow(int x, int y, int w, int h, std::vector<std::uint64_t>& out) const;
+
+    std::size_t getTileCount() const;
+    std::size_t getMemoryUsage() const;
+};
+
+#endif // RASTER_H
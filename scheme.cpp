@@ -1,95 +1,429 @@
 // scheme.cpp
 #include "scheme.h"
+#include "diagnostics.h"
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <string>
+#include <unordered_set>
 
-#ifdef _WIN32
-    #include <windows.h>
-    #include <psapi.h>
-    #pragma comment(lib, "psapi.lib")  // ← Это автоматически подключает библиотеку
-#endif
 
 
-Scheme::Scheme() : nextElementId(1) {}
+Scheme::Scheme() : elementStore(std::make_shared<ElementStore>()),
+                   nextElementId(1), layerIndexType(SpatialIndexType::GRID),
+                   journal(SpatialIndexType::GRID), replaying(false), cachedValid(true), hasCachedResult(false), cachedViolation{-1, -1, 0, 0} {
+    elementStore->attachUser(this);
+}
 
-Scheme::Scheme(const Scheme& other) {
+Scheme::Scheme(SpatialIndexType indexType)
+    : elementStore(std::make_shared<ElementStore>()), nextElementId(1), layerIndexType(indexType),
+      journal(indexType), replaying(false), cachedValid(true), hasCachedResult(false), cachedViolation{-1, -1, 0, 0} {
+    elementStore->attachUser(this);
+}
+
+Scheme::Scheme(std::shared_ptr<ElementStore> store, SpatialIndexType indexType)
+    : elementStore(store ? store : std::make_shared<ElementStore>()),
+      nextElementId(1), layerIndexType(indexType), journal(indexType), replaying(false),
+      cachedValid(true), hasCachedResult(false), cachedViolation{-1, -1, 0, 0} {
+    elementStore->attachUser(this);
+}
+
+Scheme::Scheme(const Scheme& other) : layerPool(other.layerPool) {
+    layerHandles = other.layerHandles;
+    elementStore = other.elementStore;
     nextElementId = other.nextElementId;
-    for (const auto& layer : other.layers) {
-        layers.push_back(new Layer(*layer));
+    layerIndexType = other.layerIndexType;
+    // Копия - новая ветка правок: история оригинала ей не передается
+    journal = EditJournal(layerIndexType);
+    replaying = false;
+    relinkLayers();
+    pairStates = other.pairStates;
+    knownVersions = other.knownVersions;
+    cachedValid = other.cachedValid;
+    hasCachedResult = other.hasCachedResult;
+    cachedViolation = other.cachedViolation;
+    elementStore->attachUser(this);
+}
+
+Scheme& Scheme::operator=(const Scheme& other) {
+    if (this != &other) {
+        layerPool = other.layerPool;
+        layerHandles = other.layerHandles;
+        elementStore->detachUser(this);
+        elementStore = other.elementStore;
+        elementStore->attachUser(this);
+        nextElementId = other.nextElementId;
+        layerIndexType = other.layerIndexType;
+        journal = EditJournal(layerIndexType);
+        relinkLayers();
+        pairStates = other.pairStates;
+        knownVersions = other.knownVersions;
+        cachedValid = other.cachedValid;
+        hasCachedResult = other.hasCachedResult;
+        cachedViolation = other.cachedViolation;
+        connectivity.invalidate();
     }
+    return *this;
 }
 
+void Scheme::swap(Scheme& other) {
+    // Адреса слоев в пулах не меняются, поэтому кэш указателей остается верным
+    layerPool.swap(other.layerPool);
+    layerHandles.swap(other.layerHandles);
+    layers.swap(other.layers);
+    elementStore->detachUser(this);
+    other.elementStore->detachUser(&other);
+    elementStore.swap(other.elementStore);
+    elementStore->attachUser(this);
+    other.elementStore->attachUser(&other);
+    std::swap(nextElementId, other.nextElementId);
+    std::swap(layerIndexType, other.layerIndexType);
+    std::swap(journal, other.journal);
+    pairStates.swap(other.pairStates);
+    knownVersions.swap(other.knownVersions);
+    std::swap(cachedValid, other.cachedValid);
+    std::swap(hasCachedResult, other.hasCachedResult);
+    std::swap(cachedViolation, other.cachedViolation);
+    std::swap(connectivity, other.connectivity);
+}
+
+// Слои и хранилище элементов освобождаются пулами целиком
 Scheme::~Scheme() {
-    for (auto layer : layers) {
-        delete layer;
-    }
+    elementStore->detachUser(this);
+}
+
+void Scheme::relinkLayers() {
     layers.clear();
+    for (PoolHandle handle : layerHandles) {
+        layers.push_back(layerPool.get(handle));
+    }
+}
+
+ElementHandle Scheme::createElement(int w, int h, const std::vector<std::vector<char>>& mat) {
+    return elementStore->createElement(w, h, mat);
+}
+
+ElementHandle Scheme::createMotor(int w, int h, const std::vector<std::vector<char>>& mat,
+                                  int spd, int dir) {
+    return elementStore->createMotor(w, h, mat, spd, dir);
+}
+
+Element* Scheme::getElement(ElementHandle handle) const {
+    return elementStore->get(handle);
+}
+
+std::shared_ptr<ElementStore> Scheme::getElementStore() const {
+    return elementStore;
+}
+
+bool Scheme::referencesElement(const Element* elem) const {
+    for (const Layer* layer : layers) {
+        if (layer->containsElement(elem)) {
+            return true;
+        }
+    }
+    return journal.referencesElement(elem);
+}
+
+MotorRegistry& Scheme::getMotors() {
+    return elementStore->getMotors();
+}
+
+const MotorRegistry& Scheme::getMotors() const {
+    return elementStore->getMotors();
+}
+
+bool Scheme::setMotorDirectionOnLayer(int layerIndex, int direction) {
+    if (layerIndex < 0 || layerIndex >= static_cast<int>(layers.size()) ||
+        (direction != 0 && direction != 1 && direction != 2)) {
+        return false;
+    }
+    const MotorRegistry& registry = getMotors();
+    std::vector<std::uint32_t> slots;
+    for (const auto& elemPair : layers[layerIndex]->getElements()) {
+        if (elemPair.first->getType() != ElementType::MOTOR) continue;
+        Motor* motor = static_cast<Motor*>(elemPair.first);
+        if (motor->getRegistry() == &registry) {
+            slots.push_back(motor->getRegistrySlot());
+        } else {
+            motor->setDirection(direction);
+        }
+    }
+    return getMotors().setDirection(slots, direction);
+}
+
+std::vector<Motor*> Scheme::getRunningMotors() const {
+    const MotorRegistry& registry = getMotors();
+    std::vector<std::uint32_t> slots;
+    registry.getRunning(slots);
+    std::vector<Motor*> result;
+    result.reserve(slots.size());
+    for (std::uint32_t slot : slots) {
+        result.push_back(registry.getMotor(slot));
+    }
+    return result;
 }
 
 int Scheme::createLayer() {
-    Layer* newLayer = new Layer();
+    PoolHandle handle = layerPool.create(layerIndexType);
+    Layer* newLayer = layerPool.get(handle);
+    layerHandles.push_back(handle);
     layers.push_back(newLayer);
+    pairStates.push_back(PairState{false, {}, {}});
+    knownVersions.push_back(newLayer->getVersion());
+    connectivity.onLayerCreated(layers);
+    recordEdit(EditType::CREATE_LAYER, layers.size() - 1, -1, nullptr, 0, 0);
     return layers.size() - 1;
 }
 
 bool Scheme::addElement(Element* elem, int layerIndex, int x, int y) {
+    METRIC_TIMER(ADD_ELEMENT);
     if (layerIndex < 0 || layerIndex >= layers.size()) {
-        std::cout << "Error: Layer " << layerIndex << " doesn't exist!" << std::endl;
+        METRIC_ADD(REJECTED_INVALID_LAYER, 1);
+        reportDiagnostic(DiagnosticCode::LAYER_NOT_FOUND, layerIndex, -1, x, y, 0, elem);
         return false;
     }
 
     if (!elem) {
-        std::cout << "Error: Invalid element!" << std::endl;
+        METRIC_ADD(REJECTED_INVALID_ELEMENT, 1);
+        reportDiagnostic(DiagnosticCode::INVALID_ELEMENT, layerIndex, -1, x, y);
+        return false;
+    }
+
+    if (!Layer::fitsCoordinates(x, y, elem->getWidth(), elem->getHeight())) {
+        METRIC_ADD(REJECTED_OUT_OF_RANGE, 1);
+        reportDiagnostic(DiagnosticCode::OUT_OF_RANGE, layerIndex, -1, x, y, 0, elem);
         return false;
     }
 
     Layer* targetLayer = layers[layerIndex];
 
     if (targetLayer->hasOverlap(elem, x, y)) {
-        std::cout << "Error: Element overlaps with existing elements on layer " << layerIndex << "!" << std::endl;
+        METRIC_ADD(REJECTED_OVERLAP, 1);
+        reportDiagnostic(DiagnosticCode::OVERLAP, layerIndex, -1, x, y, 0, elem);
         return false;
     }
 
     if (layerIndex > 0) {
-        Layer* lowerLayer = layers[layerIndex - 1];
-        if (!targetLayer->canPlaceWithLowerLayer(elem, x, y, lowerLayer)) {
-            std::cout << "Error: Element doesn't properly connect with layer below!" << std::endl;
+        ConnectionCheck check = targetLayer->checkLowerConnection(elem, x, y, layers[layerIndex - 1]);
+        if (!check.connected) {
+            METRIC_ADD(REJECTED_NO_CONNECTION, 1);
+            reportDiagnostic(DiagnosticCode::NO_CONNECTION, layerIndex, -1, check.failX, check.failY, 0, elem);
             return false;
         }
     }
 
-    return targetLayer->placeElement(elem, x, y);
+    unsigned long versionBefore = targetLayer->getVersion();
+    bool inSync = knownVersions[layerIndex] == versionBefore;
+    if (!targetLayer->placeElement(elem, x, y)) {
+        return false;
+    }
+    connectivity.onPlaced(layers, layerIndex, targetLayer->getElements().size() - 1, versionBefore);
+    // Новый элемент проверен при вставке; перепроверить нужно слой выше
+    if (inSync) {
+        knownVersions[layerIndex] = targetLayer->getVersion();
+    }
+    markDirty(layerIndex + 1, Rect{x, y, elem->getWidth(), elem->getHeight()});
+    METRIC_ADD(PLACEMENTS_ACCEPTED, 1);
+    recordEdit(EditType::ADD_ELEMENT, layerIndex, targetLayer->getElements().size() - 1, elem, x, y);
+    return true;
+}
+
+bool Scheme::addElement(Element* elem, Orientation o, int layerIndex, int x, int y) {
+    return addElement(elem ? elem->getOriented(o) : nullptr, layerIndex, x, y);
+}
+
+#ifdef CONSTRUCTOR_METRICS
+static void countPlacement(PlacementStatus status) {
+    switch (status) {
+        case PlacementStatus::PLACED: METRIC_ADD(PLACEMENTS_ACCEPTED, 1); break;
+        case PlacementStatus::INVALID_LAYER: METRIC_ADD(REJECTED_INVALID_LAYER, 1); break;
+        case PlacementStatus::INVALID_ELEMENT: METRIC_ADD(REJECTED_INVALID_ELEMENT, 1); break;
+        case PlacementStatus::OVERLAP_EXISTING:
+        case PlacementStatus::OVERLAP_BATCH: METRIC_ADD(REJECTED_OVERLAP, 1); break;
+        case PlacementStatus::OUT_OF_RANGE: METRIC_ADD(REJECTED_OUT_OF_RANGE, 1); break;
+        case PlacementStatus::NO_CONNECTION: METRIC_ADD(REJECTED_NO_CONNECTION, 1); break;
+        case PlacementStatus::ROLLED_BACK: METRIC_ADD(REJECTED_ROLLED_BACK, 1); break;
+    }
+}
+#endif
+
+bool Scheme::addElements(const std::vector<Placement>& batch,
+                         std::vector<PlacementStatus>* results, bool allOrNothing) {
+    std::vector<PlacementStatus> statuses(batch.size(), PlacementStatus::PLACED);
+    std::vector<std::vector<size_t>> byLayer(layers.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (batch[i].layerIndex < 0 || batch[i].layerIndex >= layers.size()) {
+            statuses[i] = PlacementStatus::INVALID_LAYER;
+        } else if (!batch[i].elem) {
+            statuses[i] = PlacementStatus::INVALID_ELEMENT;
+        } else if (!Layer::fitsCoordinates(batch[i].x, batch[i].y,
+                                           batch[i].elem->getWidth(), batch[i].elem->getHeight())) {
+            statuses[i] = PlacementStatus::OUT_OF_RANGE;
+        } else {
+            byLayer[batch[i].layerIndex].push_back(i);
+        }
+    }
+
+    // Снизу вверх: элементы пачки на нижнем слое уже стоят,
+    // когда проверяются соединения элементов над ними
+    std::vector<int> placedPerLayer(layers.size(), 0);
+    std::vector<bool> wasInSync(layers.size());
+    for (int layerIndex = 0; layerIndex < layers.size(); layerIndex++) {
+        const std::vector<size_t>& indices = byLayer[layerIndex];
+        if (indices.empty()) {
+            continue;
+        }
+        Layer* layer = layers[layerIndex];
+        std::vector<std::pair<Element*, std::pair<int, int>>> items;
+        std::vector<PlacementStatus> layerStatuses;
+        for (size_t i : indices) {
+            const Placement& item = batch[i];
+            items.push_back(std::make_pair(item.elem, std::make_pair(item.x, item.y)));
+            bool connected = layerIndex == 0 ||
+                layer->checkLowerConnection(item.elem, item.x, item.y, layers[layerIndex - 1]).connected;
+            layerStatuses.push_back(connected ? PlacementStatus::PLACED : PlacementStatus::NO_CONNECTION);
+        }
+
+        wasInSync[layerIndex] = knownVersions[layerIndex] == layer->getVersion();
+        placedPerLayer[layerIndex] = layer->placeElements(items, layerStatuses);
+        for (size_t k = 0; k < indices.size(); k++) {
+            statuses[indices[k]] = layerStatuses[k];
+        }
+    }
+
+    bool allPlaced = true;
+    for (PlacementStatus status : statuses) {
+        if (status != PlacementStatus::PLACED) {
+            allPlaced = false;
+            break;
+        }
+    }
+
+    if (!allPlaced && allOrNothing) {
+        // Пачка добавлялась в конец каждого слоя - снимаем сверху вниз
+        for (int layerIndex = layers.size() - 1; layerIndex >= 0; layerIndex--) {
+            Layer* layer = layers[layerIndex];
+            for (int k = 0; k < placedPerLayer[layerIndex]; k++) {
+                layer->removeElement(layer->getElements().size() - 1);
+            }
+            if (placedPerLayer[layerIndex] > 0 && wasInSync[layerIndex]) {
+                knownVersions[layerIndex] = layer->getVersion();
+            }
+        }
+        for (PlacementStatus& status : statuses) {
+            if (status == PlacementStatus::PLACED) {
+                status = PlacementStatus::ROLLED_BACK;
+            }
+        }
+    } else {
+        for (int layerIndex = 0; layerIndex < layers.size(); layerIndex++) {
+            if (placedPerLayer[layerIndex] > 0 && wasInSync[layerIndex]) {
+                knownVersions[layerIndex] = layers[layerIndex]->getVersion();
+            }
+        }
+        // Слой выше перепроверяется в общей рамке добавленных элементов
+        for (int layerIndex = 0; layerIndex < layers.size(); layerIndex++) {
+            int minX = 0, minY = 0, maxX = 0, maxY = 0;
+            bool any = false;
+            for (size_t i : byLayer[layerIndex]) {
+                if (statuses[i] != PlacementStatus::PLACED) continue;
+                const Placement& item = batch[i];
+                int right = item.x + item.elem->getWidth();
+                int bottom = item.y + item.elem->getHeight();
+                minX = any ? std::min(minX, item.x) : item.x;
+                minY = any ? std::min(minY, item.y) : item.y;
+                maxX = any ? std::max(maxX, right) : right;
+                maxY = any ? std::max(maxY, bottom) : bottom;
+                any = true;
+            }
+            if (any) {
+                markDirty(layerIndex + 1, Rect{minX, minY, maxX - minX, maxY - minY});
+            }
+        }
+
+        // Пачка - один шаг отмены; на каждом слое элементы шли в конец по порядку
+        journal.beginTransaction();
+        for (int layerIndex = 0; layerIndex < layers.size(); layerIndex++) {
+            int elementIndex = layers[layerIndex]->getElements().size() - placedPerLayer[layerIndex];
+            for (size_t i : byLayer[layerIndex]) {
+                if (statuses[i] == PlacementStatus::PLACED) {
+                    const Placement& item = batch[i];
+                    recordEdit(EditType::ADD_ELEMENT, layerIndex, elementIndex++, item.elem, item.x, item.y);
+                }
+            }
+        }
+        journal.commitTransaction();
+    }
+
+#ifdef CONSTRUCTOR_METRICS
+    for (PlacementStatus status : statuses) {
+        countPlacement(status);
+    }
+#endif
+    if (results) {
+        *results = statuses;
+    }
+    return allPlaced;
 }
 
 bool Scheme::removeElement(int layerIndex, int elementIndex) {
+    METRIC_TIMER(REMOVE_ELEMENT);
     if (layerIndex < 0 || layerIndex >= layers.size()) {
-        std::cout << "Error: Layer " << layerIndex << " doesn't exist!" << std::endl;
+        reportDiagnostic(DiagnosticCode::LAYER_NOT_FOUND, layerIndex);
         return false;
     }
 
     Layer* layer = layers[layerIndex];
     if (elementIndex < 0 || elementIndex >= layer->getElements().size()) {
-        std::cout << "Error: Element " << elementIndex << " doesn't exist on layer " << layerIndex << "!" << std::endl;
+        reportDiagnostic(DiagnosticCode::ELEMENT_NOT_FOUND, layerIndex, elementIndex);
         return false;
     }
 
+    const auto& removed = layer->getElements()[elementIndex];
+    const Shape& placedShape = layer->getPlacedShape(elementIndex);
+    Rect region{removed.second.first, removed.second.second,
+                placedShape.getWidth(), placedShape.getHeight()};
+    pairStates[layerIndex].violating.erase(layer->getPlacementId(elementIndex));
+
+    recordEdit(EditType::REMOVE_ELEMENT, layerIndex, elementIndex, removed.first,
+               removed.second.first, removed.second.second);
+
+    int placementId = layer->getPlacementId(elementIndex);
+    unsigned long versionBefore = layer->getVersion();
+    bool inSync = knownVersions[layerIndex] == versionBefore;
     layer->removeElement(elementIndex);
+    if (inSync) {
+        knownVersions[layerIndex] = layer->getVersion();
+    }
+    connectivity.onRemoved(layers, layerIndex, placementId, versionBefore);
+    markDirty(layerIndex + 1, region);
     return true;
 }
 
 bool Scheme::removeLayer(int layerIndex) {
     if (layerIndex < 0 || layerIndex >= layers.size()) {
-        std::cout << "Error: Layer " << layerIndex << " doesn't exist!" << std::endl;
+        reportDiagnostic(DiagnosticCode::LAYER_NOT_FOUND, layerIndex);
         return false;
     }
 
     Layer* layer = layers[layerIndex];
     if (!layer->isEmpty() && layerIndex < layers.size() - 1) {
-        std::cout << "Error: Cannot delete non-empty layer with layers above!" << std::endl;
+        reportDiagnostic(DiagnosticCode::LAYER_NOT_EMPTY, layerIndex);
         return false;
     }
 
-    delete layers[layerIndex];
+    if (!replaying) {
+        EditRecord edit{EditType::REMOVE_LAYER, false, layerIndex, -1, nullptr, 0, 0,
+                        std::make_shared<const Layer>(*layer)};
+        journal.record(edit);
+    }
+    layerPool.destroy(layerHandles[layerIndex]);
+    layerHandles.erase(layerHandles.begin() + layerIndex);
     layers.erase(layers.begin() + layerIndex);
+    // Индексы слоев сдвинулись - проверяем все пары заново
+    resetValidation();
     return true;
 }
 
@@ -100,72 +434,549 @@ Layer* Scheme::getLayer(int layerIndex) {
     return layers[layerIndex];
 }
 
+const Layer* Scheme::getLayer(int layerIndex) const {
+    if (layerIndex < 0 || layerIndex >= layers.size()) {
+        return nullptr;
+    }
+    return layers[layerIndex];
+}
+
+SpatialIndexType Scheme::getIndexType() const {
+    return layerIndexType;
+}
+
+PoolHandle Scheme::getLayerHandle(int layerIndex) const {
+    if (layerIndex < 0 || layerIndex >= layerHandles.size()) {
+        return INVALID_POOL_HANDLE;
+    }
+    return layerHandles[layerIndex];
+}
+
+Layer* Scheme::getLayer(PoolHandle handle) const {
+    return layerPool.get(handle);
+}
+
+int Scheme::findLayerIndex(PoolHandle handle) const {
+    for (int i = 0; i < layerHandles.size(); i++) {
+        if (layerHandles[i] == handle) {
+            return i;
+        }
+    }
+    return -1;
+}
+
 int Scheme::getLayerCount() const {
     return layers.size();
 }
 
+void Scheme::markDirty(int upperLayerIndex, const Rect& region) {
+    if (upperLayerIndex <= 0 || upperLayerIndex >= pairStates.size()) {
+        return;
+    }
+    PairState& state = pairStates[upperLayerIndex];
+    if (!state.fullCheck) {
+        state.dirty.push_back(region);
+    }
+    hasCachedResult = false;
+}
+
+void Scheme::resetValidation() {
+    pairStates.assign(layers.size(), PairState{true, {}, {}});
+    knownVersions.clear();
+    for (Layer* layer : layers) {
+        knownVersions.push_back(layer->getVersion());
+    }
+    hasCachedResult = false;
+    // Слои сдвинулись или заменены - граф соединений строится заново
+    connectivity.invalidate();
+}
+
+bool Scheme::checkPlacement(int layerIndex, const IndexEntry& entry) const {
+    ConnectionCheck check = layers[layerIndex]->checkLowerConnection(
+        *entry.shape, entry.x, entry.y, layers[layerIndex - 1]);
+    return check.connected;
+}
+
+void Scheme::refreshValidation() const {
+    // Слои, измененные в обход схемы (через getLayer), проверяются целиком
+    for (int i = 0; i < layers.size(); i++) {
+        if (layers[i]->getVersion() != knownVersions[i]) {
+            knownVersions[i] = layers[i]->getVersion();
+            pairStates[i].fullCheck = true;
+            if (i + 1 < pairStates.size()) {
+                pairStates[i + 1].fullCheck = true;
+            }
+            hasCachedResult = false;
+        }
+    }
+    if (hasCachedResult) {
+        return;
+    }
+
+    std::vector<IndexEntry> touched;
+    for (int i = 1; i < layers.size(); i++) {
+        PairState& state = pairStates[i];
+        if (state.fullCheck) {
+            state.violating.clear();
+            layers[i]->findElementsIn(Rect{layers[i]->getMinX(), layers[i]->getMinY(),
+                                           layers[i]->getWidth(), layers[i]->getHeight()},
+                                      touched);
+            for (const IndexEntry& entry : touched) {
+                if (!checkPlacement(i, entry)) {
+                    state.violating.insert(entry.id);
+                }
+            }
+        } else {
+            for (const Rect& region : state.dirty) {
+                layers[i]->findElementsIn(region, touched);
+                for (const IndexEntry& entry : touched) {
+                    if (checkPlacement(i, entry)) {
+                        state.violating.erase(entry.id);
+                    } else {
+                        state.violating.insert(entry.id);
+                    }
+                }
+            }
+        }
+        state.fullCheck = false;
+        state.dirty.clear();
+    }
+
+    // Первое нарушение - как при полном обходе: по слоям, затем по порядку элементов
+    cachedValid = true;
+    for (int i = 1; i < layers.size() && cachedValid; i++) {
+        const PairState& state = pairStates[i];
+        if (state.violating.empty()) {
+            continue;
+        }
+        int firstIndex = -1;
+        for (int id : state.violating) {
+            int index = layers[i]->findPlacementIndex(id);
+            if (index >= 0 && (firstIndex < 0 || index < firstIndex)) {
+                firstIndex = index;
+            }
+        }
+        if (firstIndex < 0) {
+            continue;
+        }
+        const auto& placed = layers[i]->getElements()[firstIndex];
+        ConnectionCheck check = layers[i]->checkLowerConnection(
+            layers[i]->getPlacedShape(firstIndex), placed.second.first, placed.second.second, layers[i - 1]);
+        cachedValid = false;
+        cachedViolation = Violation{i, firstIndex, check.failX, check.failY};
+    }
+    hasCachedResult = true;
+}
+
+std::vector<std::pair<int, int>> Scheme::findPlacements(Element* elem, int layerIndex, const Rect& region,
+                                                        std::size_t limit) const {
+    std::vector<std::pair<int, int>> positions;
+    if (layerIndex < 0 || layerIndex >= layers.size() || !elem) {
+        return positions;
+    }
+    const Layer* lowerLayer = layerIndex > 0 ? layers[layerIndex - 1] : nullptr;
+    layers[layerIndex]->findPlacements(elem, region, lowerLayer, positions, limit);
+    return positions;
+}
+
 bool Scheme::validateStructure() const {
+    METRIC_TIMER(VALIDATE_STRUCTURE);
+    refreshValidation();
+    if (!cachedValid && diagnosticsEnabled()) {
+        reportViolations();
+    }
+    return cachedValid;
+}
+
+// Все нарушения из кэша проверки, по слоям и по порядку элементов
+void Scheme::reportViolations() const {
     for (int i = 1; i < layers.size(); i++) {
-        Layer* currentLayer = layers[i];
-        Layer* lowerLayer = layers[i - 1];
+        const std::set<int>& violating = pairStates[i].violating;
+        if (violating.empty()) {
+            continue;
+        }
+        const auto& elements = layers[i]->getElements();
+        for (int index = 0; index < elements.size(); index++) {
+            if (!violating.count(layers[i]->getPlacementId(index))) {
+                continue;
+            }
+            const auto& placed = elements[index];
+            ConnectionCheck check = layers[i]->checkLowerConnection(
+                layers[i]->getPlacedShape(index), placed.second.first, placed.second.second, layers[i - 1]);
+            reportDiagnostic(DiagnosticCode::BROKEN_CONNECTION, i, index, check.failX, check.failY, 0,
+                             placed.first);
+        }
+    }
+}
 
-        const auto& elements = currentLayer->getElements();
-        for (const auto& elemPair : elements) {
-            Element* elem = elemPair.first;
-            int x = elemPair.second.first;
-            int y = elemPair.second.second;
+bool Scheme::areConnected(int layerA, int elementA, int layerB, int elementB) const {
+    connectivity.sync(layers);
+    int componentA = connectivity.getComponent(layers, layerA, elementA);
+    return componentA >= 0 && componentA == connectivity.getComponent(layers, layerB, elementB);
+}
+
+int Scheme::getComponentId(int layerIndex, int elementIndex) const {
+    connectivity.sync(layers);
+    return connectivity.getComponent(layers, layerIndex, elementIndex);
+}
+
+int Scheme::getComponentCount() const {
+    connectivity.sync(layers);
+    return connectivity.getComponentCount();
+}
+
+std::size_t Scheme::getConnectionCount() const {
+    connectivity.sync(layers);
+    return connectivity.getEdgeCount();
+}
+
+void Scheme::getConnections(std::vector<ElementLink>& out) const {
+    collectLinks(layers, out);
+}
+
+bool Scheme::getFirstViolation(Violation& violation) const {
+    refreshValidation();
+    if (cachedValid) {
+        return false;
+    }
+    violation = cachedViolation;
+    return true;
+}
+
+bool Scheme::validateStructureParallel(ThreadPool& pool, std::vector<Violation>* report,
+                                       bool stopOnFirst) const {
+    const int CHUNK_SIZE = 256;
+
+    // Задача - (слой, отрезок элементов); у каждой своя ячейка результата
+    struct Task {
+        int layerIndex;
+        int begin;
+        int end;
+    };
+    std::vector<Task> tasks;
+    for (int i = 1; i < layers.size(); i++) {
+        int count = layers[i]->getElements().size();
+        for (int begin = 0; begin < count; begin += CHUNK_SIZE) {
+            tasks.push_back(Task{i, begin, std::min(count, begin + CHUNK_SIZE)});
+        }
+    }
 
-            if (!currentLayer->canPlaceWithLowerLayer(elem, x, y, lowerLayer)) {
-                std::cout << "Validation failed: Element on layer " << i
-                          << " at (" << x << "," << y << ") doesn't connect properly!" << std::endl;
+    std::vector<std::vector<Violation>> results(tasks.size());
+    // Номер самой ранней задачи с нарушением: более поздние можно отменить
+    std::atomic<size_t> firstFailedTask(tasks.size());
+
+    for (size_t t = 0; t < tasks.size(); t++) {
+        pool.submit([this, t, &tasks, &results, &firstFailedTask, stopOnFirst]() {
+            if (stopOnFirst && firstFailedTask.load() < t) {
+                return;
+            }
+            const Task& task = tasks[t];
+            const Layer* upper = layers[task.layerIndex];
+            const Layer* lower = layers[task.layerIndex - 1];
+            const auto& elements = upper->getElements();
+            for (int e = task.begin; e < task.end; e++) {
+                ConnectionCheck check = upper->checkLowerConnection(
+                    upper->getPlacedShape(e), elements[e].second.first, elements[e].second.second, lower);
+                if (check.connected) {
+                    continue;
+                }
+                results[t].push_back(Violation{task.layerIndex, e, check.failX, check.failY});
+                if (stopOnFirst) {
+                    size_t seen = firstFailedTask.load();
+                    while (t < seen && !firstFailedTask.compare_exchange_weak(seen, t)) {
+                    }
+                    return;
+                }
+            }
+        });
+    }
+    pool.wait();
+
+    bool valid = true;
+    for (const std::vector<Violation>& taskViolations : results) {
+        for (const Violation& violation : taskViolations) {
+            valid = false;
+            if (report) {
+                report->push_back(violation);
+            }
+            if (stopOnFirst) {
                 return false;
             }
         }
     }
+    return valid;
+}
+
+void Scheme::recordEdit(EditType type, int layerIndex, int elementIndex, Element* elem, int x, int y) {
+    if (!replaying) {
+        journal.record(EditRecord{type, false, layerIndex, elementIndex, elem, x, y, nullptr});
+    }
+}
+
+void Scheme::insertPlaced(int layerIndex, int elementIndex, Element* elem, int x, int y) {
+    Layer* layer = layers[layerIndex];
+    unsigned long versionBefore = layer->getVersion();
+    bool inSync = knownVersions[layerIndex] == versionBefore;
+    layer->insertElement(elementIndex, elem, x, y);
+    if (inSync) {
+        knownVersions[layerIndex] = layer->getVersion();
+    }
+    connectivity.onPlaced(layers, layerIndex, elementIndex, versionBefore);
+    // Вернувшийся элемент проверяется над своим нижним слоем, а слой выше - над ним
+    Rect region{x, y, elem->getWidth(), elem->getHeight()};
+    markDirty(layerIndex, region);
+    markDirty(layerIndex + 1, region);
+}
+
+void Scheme::insertLayer(int layerIndex, const Layer& layer) {
+    layerHandles.insert(layerHandles.begin() + layerIndex, layerPool.create(layer));
+    relinkLayers();
+    resetValidation();
+}
+
+void Scheme::applyEdit(const EditRecord& edit) {
+    switch (edit.type) {
+        case EditType::ADD_ELEMENT:
+            insertPlaced(edit.layerIndex, edit.elementIndex, edit.elem, edit.x, edit.y);
+            break;
+        case EditType::REMOVE_ELEMENT:
+            removeElement(edit.layerIndex, edit.elementIndex);
+            break;
+        case EditType::CREATE_LAYER:
+            createLayer();
+            break;
+        case EditType::REMOVE_LAYER:
+            removeLayer(edit.layerIndex);
+            break;
+    }
+}
+
+void Scheme::revertEdit(const EditRecord& edit) {
+    switch (edit.type) {
+        case EditType::ADD_ELEMENT:
+            removeElement(edit.layerIndex, edit.elementIndex);
+            break;
+        case EditType::REMOVE_ELEMENT:
+            insertPlaced(edit.layerIndex, edit.elementIndex, edit.elem, edit.x, edit.y);
+            break;
+        case EditType::CREATE_LAYER:
+            removeLayer(edit.layerIndex);
+            break;
+        case EditType::REMOVE_LAYER:
+            insertLayer(edit.layerIndex, *edit.layer);
+            break;
+    }
+}
+
+bool Scheme::undo() {
+    std::vector<EditRecord> step;
+    if (!journal.takeUndoStep(step)) {
+        return false;
+    }
+    replaying = true;
+    for (const EditRecord& edit : step) {
+        revertEdit(edit);
+    }
+    replaying = false;
     return true;
 }
 
-void Scheme::display() const {
+bool Scheme::redo() {
+    std::vector<EditRecord> step;
+    if (!journal.takeRedoStep(step)) {
+        return false;
+    }
+    replaying = true;
+    for (const EditRecord& edit : step) {
+        applyEdit(edit);
+    }
+    replaying = false;
+    return true;
+}
+
+bool Scheme::canUndo() const {
+    return journal.getUndoSteps() > 0 && !journal.inTransaction();
+}
+
+bool Scheme::canRedo() const {
+    return journal.getRedoSteps() > 0 && !journal.inTransaction();
+}
+
+void Scheme::beginTransaction() {
+    journal.beginTransaction();
+}
+
+bool Scheme::commitTransaction() {
+    return journal.commitTransaction();
+}
+
+bool Scheme::rollbackTransaction() {
+    if (!journal.inTransaction()) {
+        return false;
+    }
+    std::vector<EditRecord> step;
+    journal.takeTransaction(step);
+    replaying = true;
+    for (const EditRecord& edit : step) {
+        revertEdit(edit);
+    }
+    replaying = false;
+    return true;
+}
+
+void Scheme::setHistoryLimit(std::size_t steps) {
+    journal.setHistoryLimit(steps);
+}
+
+std::size_t Scheme::getHistorySize() const {
+    return journal.getUndoSteps();
+}
+
+void Scheme::clearHistory() {
+    journal.clear();
+}
+
+void Scheme::checkpoint() {
+    journal.setCheckpoint(layers);
+}
+
+bool Scheme::restoreCheckpoint() {
+    const std::vector<Layer>* snapshot = journal.getCheckpoint();
+    if (!snapshot) {
+        return false;
+    }
+    for (PoolHandle handle : layerHandles) {
+        layerPool.destroy(handle);
+    }
+    layerHandles.clear();
+    for (const Layer& layer : *snapshot) {
+        layerHandles.push_back(layerPool.create(layer));
+    }
+    relinkLayers();
+    resetValidation();
+    journal.clear();
+    return true;
+}
+
+void Scheme::render(std::string& out, const Rect* viewport, int scale, int overviewCells) const {
     if (layers.empty()) {
-        std::cout << "Scheme is empty!" << std::endl << std::endl;
+        out += "Scheme is empty!\n\n";
         return;
     }
 
-    std::cout << "=== SCHEME (" << layers.size() << " layers) ===" << std::endl;
+    out += "=== SCHEME (" + std::to_string(layers.size()) + " layers) ===\n";
 
     for (int i = 0; i < layers.size(); i++) {
-        std::cout << "--- LAYER " << i << " ---" << std::endl;
-        layers[i]->display();
+        out += "--- LAYER " + std::to_string(i) + " ---\n";
+        const Layer* layer = layers[i];
+        if (viewport) {
+            layer->render(out, *viewport, scale);
+        } else {
+            Rect bounds = {layer->getMinX(), layer->getMinY(), layer->getWidth(), layer->getHeight()};
+            layer->render(out, bounds, overviewCells > 0 ? layer->getOverviewScale(overviewCells) : 1);
+        }
     }
 
-    if (validateStructure()) {
-        std::cout << "Structure is valid" << std::endl;
+    Violation violation;
+    if (getFirstViolation(violation)) {
+        const auto& placed = layers[violation.layerIndex]->getElements()[violation.elementIndex];
+        out += "Validation failed: Element on layer " + std::to_string(violation.layerIndex) +
+               " at (" + std::to_string(placed.second.first) + "," + std::to_string(placed.second.second) +
+               ") doesn't connect properly!\n";
+        out += "Structure has connection issues!\n";
     } else {
-        std::cout << "Structure has connection issues!" << std::endl;
+        out += "Structure is valid\n";
     }
-    std::cout << std::endl;
+    out += "\n";
+}
+
+static void writeOut(const std::string& out) {
+    std::cout.write(out.data(), out.size());
+    std::cout.flush();
+}
+
+void Scheme::render(std::string& out) const {
+    render(out, nullptr, 1, 0);
+}
+
+void Scheme::display() const {
+    std::string out;
+    render(out);
+    writeOut(out);
+}
+
+void Scheme::display(const Rect& viewport, int scale) const {
+    std::string out;
+    render(out, &viewport, scale, 0);
+    writeOut(out);
+}
+
+void Scheme::displayOverview(int maxCells) const {
+    std::string out;
+    render(out, nullptr, 1, std::max(maxCells, 1));
+    writeOut(out);
 }
 
 void Scheme::showMemoryUsage() const {
-    std::cout << "\n=== MEMORY USAGE ===" << std::endl;
+    showMemoryUsage(std::cout);
+}
 
-#ifdef _WIN32
-    HANDLE hProcess = GetCurrentProcess();
-    PROCESS_MEMORY_COUNTERS pmc;
-    if (GetProcessMemoryInfo(hProcess, &pmc, sizeof(pmc))) {
-        std::cout << "Memory (RAM usage): " << pmc.WorkingSetSize / 1024 << " KB" << std::endl;
+void Scheme::showMemoryUsage(std::ostream& os) const {
+    os << "\n=== MEMORY USAGE ===" << std::endl;
+
+    ProcessMemory process = readProcessMemory();
+    if (process.available) {
+        os << "Memory (RAM usage): " << process.residentKb << " KB, peak: "
+                  << process.peakKb << " KB" << std::endl;
+    } else if (process.peakKb > 0) {
+        os << "Memory (peak RAM usage): " << process.peakKb << " KB" << std::endl;
     } else {
-        std::cout << "Could not get memory info." << std::endl;
+        os << "Could not get memory info." << std::endl;
     }
-#else
-    std::cout << "Memory monitoring: Windows only." << std::endl;
-#endif
 }
 
 
+std::size_t SchemeMemoryStats::total() const {
+    std::size_t bytes = shapes + elements + journal + validation + connectivity;
+    for (const LayerMemoryStats& layer : layers) {
+        bytes += layer.total();
+    }
+    return bytes;
+}
+
+SchemeMemoryStats Scheme::getMemoryStats() const {
+    SchemeMemoryStats stats;
+    stats.shapes = 0;
+    std::unordered_set<const Shape*> seenShapes;
+    for (const Layer* layer : layers) {
+        stats.layers.push_back(layer->getMemoryStats());
+        for (const auto& elemPair : layer->getElements()) {
+            const Shape* shape = &elemPair.first->getShape();
+            if (seenShapes.insert(shape).second) {
+                stats.shapes += shape->getMemoryUsage();
+            }
+        }
+    }
+    stats.elements = elementStore->getMemoryUsage();
+    stats.journal = journal.getMemoryUsage();
+    stats.validation = knownVersions.capacity() * sizeof(unsigned long) +
+                       pairStates.capacity() * sizeof(PairState);
+    for (const PairState& state : pairStates) {
+        stats.validation += state.dirty.capacity() * sizeof(Rect) +
+                            state.violating.size() * (sizeof(int) + 4 * sizeof(void*));
+    }
+    stats.connectivity = connectivity.getMemoryUsage();
+    stats.process = readProcessMemory();
+    return stats;
+}
+
 void Scheme::getStats() const {
-    std::cout << "=== SCHEME STATISTICS ===" << std::endl;
-    std::cout << "Total layers: " << layers.size() << std::endl;
+    getStats(std::cout);
+}
+
+void Scheme::getStats(std::ostream& os) const {
+    os << "=== SCHEME STATISTICS ===" << std::endl;
+    os << "Total layers: " << layers.size() << std::endl;
 
     int totalElements = 0;
     int totalMotors = 0;
@@ -180,12 +991,46 @@ void Scheme::getStats() const {
             }
         }
 
-        std::cout << "Layer " << i << ": " << elements.size() << " elements, "
+        os << "Layer " << i << ": " << elements.size() << " elements, "
                   << "size: " << layers[i]->getWidth() << "x" << layers[i]->getHeight() << std::endl;
     }
 
-    std::cout << "Total elements: " << totalElements << std::endl;
-    std::cout << "Total motors: " << totalMotors << std::endl;
-    showMemoryUsage();
-    std::cout << std::endl;
+    os << "Total elements: " << totalElements << std::endl;
+    os << "Total motors: " << totalMotors << std::endl;
+
+    SchemeMemoryStats memory = getMemoryStats();
+    os << "\n=== LOGICAL MEMORY (bytes) ===" << std::endl;
+    for (int i = 0; i < memory.layers.size(); i++) {
+        const LayerMemoryStats& layer = memory.layers[i];
+        os << "Layer " << i << ": " << layer.total()
+                  << " (placements " << layer.placements << ", bounds " << layer.bounds
+                  << ", raster " << layer.raster << ", index " << layer.index << ")"
+                  << (layer.shared ? " [shared]" : "") << std::endl;
+    }
+    os << "Shapes: " << memory.shapes << std::endl;
+    os << "Element store: " << memory.elements << std::endl;
+    os << "Edit journal: " << memory.journal << std::endl;
+    os << "Validation cache: " << memory.validation << std::endl;
+    os << "Connectivity graph: " << memory.connectivity << std::endl;
+    os << "Total: " << memory.total() << std::endl;
+    showMemoryUsage(os);
+
+    MetricsSnapshot metrics = getMetrics();
+    os << "\n=== METRICS ===" << std::endl;
+    if (!metrics.enabled) {
+        os << "Disabled (build with -DCONSTRUCTOR_METRICS)" << std::endl;
+    } else {
+        for (int c = 0; c < METRIC_COUNTER_COUNT; c++) {
+            os << getMetricName(static_cast<MetricCounter>(c)) << ": "
+                      << metrics.counters[c] << std::endl;
+        }
+        for (int t = 0; t < METRIC_TIMER_COUNT; t++) {
+            const LatencyHistogram& histogram = metrics.timers[t];
+            os << getMetricName(static_cast<MetricTimer>(t)) << ": " << histogram.count
+                      << " calls, mean " << static_cast<long long>(histogram.meanNs()) << " ns"
+                      << ", p50 < " << histogram.percentileNs(0.5) << " ns"
+                      << ", p99 < " << histogram.percentileNs(0.99) << " ns" << std::endl;
+        }
+    }
+    os << std::endl;
 }
@@ -2,30 +2,198 @@
 #ifndef SCHEME_H
 #define SCHEME_H
 
+#include "connectivity.h"
 #include "element.h"
+#include "journal.h"
 #include "layer.h"
+#include "memory.h"
+#include "pool.h"
+#include "threadpool.h"
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <set>
+#include <string>
 #include <vector>
 
+// Нарушение соединения: элемент слоя layerIndex не стоит на гнездах
+struct Violation {
+    int layerIndex;
+    int elementIndex;
+    int x; // первая клетка-соединитель без гнезда
+    int y;
+};
+
+// Элемент пачки для Scheme::addElements
+struct Placement {
+    Element* elem;
+    int layerIndex;
+    int x;
+    int y;
+};
+
+// Память схемы по структурам, в байтах
+struct SchemeMemoryStats {
+    std::vector<LayerMemoryStats> layers; // снизу вверх
+    std::size_t shapes;     // формы размещенных элементов (каждая один раз)
+    std::size_t elements;   // ячейки хранилища элементов и моторов
+    std::size_t journal;    // журнал правок
+    std::size_t validation; // кэш проверки структуры
+    std::size_t connectivity; // граф соединений элементов
+    ProcessMemory process;
+
+    std::size_t total() const;
+};
+
 class Scheme {
 private:
-    std::vector<Layer*> layers;
+    // Состояние проверки пары слоев (i, i - 1), хранится для верхнего слоя i
+    struct PairState {
+        bool fullCheck;           // проверить все элементы слоя
+        std::vector<Rect> dirty;  // измененные области нижнего слоя
+        std::set<int> violating;  // id размещений с нарушениями
+    };
+
+    ObjectPool<Layer> layerPool;
+    std::vector<PoolHandle> layerHandles; // порядок слоев снизу вверх
+    std::vector<Layer*> layers;           // адреса слоев в пуле (устойчивы)
+    std::shared_ptr<ElementStore> elementStore;
     int nextElementId;
+    SpatialIndexType layerIndexType; // тип индекса для новых слоев
+
+    // Журнал правок для undo/redo; при отмене и повторе правки не пишутся
+    EditJournal journal;
+    bool replaying;
+
+    // Кэш проверки структуры
+    mutable std::vector<PairState> pairStates;
+    mutable std::vector<unsigned long> knownVersions;
+    mutable bool cachedValid;
+    mutable bool hasCachedResult;
+    mutable Violation cachedViolation;
+
+    // Компоненты связности элементов; перестраивается лениво
+    mutable ConnectivityIndex connectivity;
+
+    void relinkLayers();
+    void markDirty(int upperLayerIndex, const Rect& region);
+    void resetValidation();
+    bool checkPlacement(int layerIndex, const IndexEntry& entry) const;
+    void refreshValidation() const;
+    void reportViolations() const;
+    void recordEdit(EditType type, int layerIndex, int elementIndex, Element* elem, int x, int y);
+    void insertPlaced(int layerIndex, int elementIndex, Element* elem, int x, int y);
+    void insertLayer(int layerIndex, const Layer& layer);
+    void applyEdit(const EditRecord& edit);
+    void revertEdit(const EditRecord& edit);
+    // Кадр схемы: viewport == nullptr - границы каждого слоя;
+    // overviewCells > 0 - масштаб подбирается под этот размер
+    void render(std::string& out, const Rect* viewport, int scale, int overviewCells) const;
 
 public:
     Scheme();
+    explicit Scheme(SpatialIndexType indexType);
+    // Схема с уже существующим хранилищем элементов
+    explicit Scheme(std::shared_ptr<ElementStore> store,
+                    SpatialIndexType indexType = SpatialIndexType::GRID);
+    // Копия разделяет содержимое слоев до первого изменения и хранилище элементов;
+    // журнал правок у копии свой, пустой
     Scheme(const Scheme& other);
+    Scheme& operator=(const Scheme& other);
+    void swap(Scheme& other); // обмен содержимым без копирования слоев
+    SpatialIndexType getIndexType() const;
     ~Scheme();
 
+    // Элементы, которыми владеет схема (освобождаются вместе с хранилищем)
+    ElementHandle createElement(int w, int h, const std::vector<std::vector<char>>& mat);
+    ElementHandle createMotor(int w, int h, const std::vector<std::vector<char>>& mat,
+                              int spd = 0, int dir = 0);
+    Element* getElement(ElementHandle handle) const;
+    std::shared_ptr<ElementStore> getElementStore() const;
+    // Нужен ли elem (или его повернутая копия) слоям, истории или точке отката
+    bool referencesElement(const Element* elem) const;
+
+    // Реестр моторов хранилища: групповые команды и запросы по всем моторам
+    MotorRegistry& getMotors();
+    const MotorRegistry& getMotors() const;
+    // Направление всем моторам, размещенным на слое (и отдельным, не из хранилища)
+    bool setMotorDirectionOnLayer(int layerIndex, int direction);
+    // Работающие моторы хранилища в порядке их дескрипторов
+    std::vector<Motor*> getRunningMotors() const;
+
     int createLayer();
     bool addElement(Element* elem, int layerIndex, int x, int y);
+    // Элемент в ориентации o; в слое и журнале будет elem->getOriented(o)
+    bool addElement(Element* elem, Orientation o, int layerIndex, int x, int y);
+    // Пакетное добавление: слои обрабатываются снизу вверх, на каждом слое
+    // пересечения проверяются одним проходом. results[i] - итог для batch[i].
+    // При allOrNothing любая ошибка отменяет всю пачку.
+    bool addElements(const std::vector<Placement>& batch,
+                     std::vector<PlacementStatus>* results = nullptr,
+                     bool allOrNothing = true);
     bool removeElement(int layerIndex, int elementIndex);
     bool removeLayer(int layerIndex);
     Layer* getLayer(int layerIndex);
+    const Layer* getLayer(int layerIndex) const;
+    PoolHandle getLayerHandle(int layerIndex) const;
+    Layer* getLayer(PoolHandle handle) const;
+    // Индекс слоя по дескриптору, -1 если слой удален
+    int findLayerIndex(PoolHandle handle) const;
     int getLayerCount() const;
+    // Все позиции в region, куда addElement(elem, layerIndex, x, y) поставил бы
+    // элемент, по строкам; limit > 0 - только первые limit позиций
+    std::vector<std::pair<int, int>> findPlacements(Element* elem, int layerIndex, const Rect& region,
+                                                    std::size_t limit = 0) const;
+    // Ошибки операций и нарушения (при проверке - все, а не только первое)
+    // уходят в приемник диагностики потока, см. diagnostics.h
     bool validateStructure() const;
+
+    // Связность: элементы соединены, если соединитель одного стоит на гнезде
+    // другого (напрямую или через цепочку). -1 - нет такого элемента
+    bool areConnected(int layerA, int elementA, int layerB, int elementB) const;
+    int getComponentId(int layerIndex, int elementIndex) const;
+    int getComponentCount() const; // отдельных сборок (одиночный элемент - тоже сборка)
+    std::size_t getConnectionCount() const; // пар соединенных элементов
+    void getConnections(std::vector<ElementLink>& out) const;
+    // Первое нарушение последней проверки (false, если структура корректна)
+    bool getFirstViolation(Violation& violation) const;
+    // Полная параллельная проверка всех пар слоев. report получает нарушения
+    // в порядке слоев и элементов; при stopOnFirst - только первое.
+    bool validateStructureParallel(ThreadPool& pool, std::vector<Violation>* report = nullptr,
+                                   bool stopOnFirst = true) const;
+
+    // Отмена и повтор правок: addElement(s), removeElement, createLayer, removeLayer.
+    // Правки в обход схемы (через getLayer) в журнал не попадают.
+    bool undo();
+    bool redo();
+    bool canUndo() const;
+    bool canRedo() const;
+    // Правки между begin и commit отменяются одним шагом
+    void beginTransaction();
+    bool commitTransaction();
+    bool rollbackTransaction();
+    void setHistoryLimit(std::size_t steps);
+    std::size_t getHistorySize() const; // шагов, доступных для отмены
+    // Точка отката: снимок слоев без копирования содержимого. При переполнении
+    // истории старые шаги сворачиваются в нее, поэтому restoreCheckpoint
+    // возвращает самое раннее доступное состояние.
+    void checkpoint();
+    bool restoreCheckpoint();
+    // Забывает шаги undo/redo (например, после загрузки схемы из файла)
+    void clearHistory();
+
+    // Кадр собирается в одну строку и выводится одной записью
+    void render(std::string& out) const; // дописывает кадр display() в out
     void display() const;
+    // Только область viewport каждого слоя, блоками scale x scale
+    void display(const Rect& viewport, int scale = 1) const;
+    // Обзор: каждый слой ужимается до maxCells клеток по большей стороне
+    void displayOverview(int maxCells = 64) const;
     void getStats() const;
+    void getStats(std::ostream& os) const;
+    SchemeMemoryStats getMemoryStats() const;
     void showMemoryUsage() const;
+    void showMemoryUsage(std::ostream& os) const;
 };
 
 #endif // SCHEME_H
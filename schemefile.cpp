@@ -0,0 +1,396 @@
+// schemefile.cpp
+#include "schemefile.h"
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_WIN32)
+    #include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define SCHEMEFILE_MMAP 1
+#endif
+
+static const char FILE_MAGIC[8] = {'C', 'N', 'S', 'T', 'R', 'S', 'C', 'H'};
+static const std::size_t HEADER_SIZE = 48;
+static const std::size_t SHAPE_ENTRY_SIZE = 16;
+static const std::size_t ELEMENT_ENTRY_SIZE = 16;
+static const std::size_t PLACEMENT_SIZE = 12;
+
+// Кодирование little-endian
+
+static void putU32(std::string& out, std::uint32_t value) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static void putU64(std::string& out, std::uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+static std::uint32_t getU32(const unsigned char* data) {
+    return static_cast<std::uint32_t>(data[0]) | (static_cast<std::uint32_t>(data[1]) << 8) |
+           (static_cast<std::uint32_t>(data[2]) << 16) | (static_cast<std::uint32_t>(data[3]) << 24);
+}
+
+// Число в дополнительном коде (приведение uint32 -> int больше INT_MAX
+// до C++20 зависит от реализации)
+static int getI32(const unsigned char* data) {
+    std::uint32_t value = getU32(data);
+    return (value & 0x80000000u) ? -static_cast<int>(~value) - 1 : static_cast<int>(value);
+}
+
+static std::uint64_t getU64(const unsigned char* data) {
+    return static_cast<std::uint64_t>(getU32(data)) |
+           (static_cast<std::uint64_t>(getU32(data + 4)) << 32);
+}
+
+static bool hostIsLittleEndian() {
+    const std::uint16_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+static bool fail(std::string* error, const std::string& message) {
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+static void putPlane(std::string& out, const BitPlane& plane, std::size_t wordCount) {
+    for (std::size_t i = 0; i < wordCount; i++) {
+        putU64(out, i < plane.getWordCount() ? plane.getData()[i] : 0);
+    }
+}
+
+static std::size_t planeWords(std::uint32_t width, std::uint32_t height) {
+    return static_cast<std::size_t>((width + BitPlane::WORD_BITS - 1) / BitPlane::WORD_BITS) * height;
+}
+
+bool saveScheme(const Scheme& scheme, const std::string& path, std::string* error) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return fail(error, "cannot open " + path + " for writing");
+    }
+    file.write(std::string(HEADER_SIZE, '\0').data(), HEADER_SIZE);
+
+    // Элементы и формы нумеруются по мере появления в слоях
+    std::unordered_map<const Element*, std::uint32_t> elementIndex;
+    std::vector<const Element*> elementList;
+    std::unordered_map<const Shape*, std::uint32_t> shapeIndex;
+    std::vector<const Shape*> shapeList;
+
+    std::uint64_t offset = HEADER_SIZE;
+    std::string chunk;
+    for (int i = 0; i < scheme.getLayerCount(); i++) {
+        const auto& placed = scheme.getLayer(i)->getElements();
+        chunk.clear();
+        putU32(chunk, static_cast<std::uint32_t>(placed.size()));
+        for (const auto& elemPair : placed) {
+            const Element* elem = elemPair.first;
+            auto known = elementIndex.find(elem);
+            std::uint32_t index;
+            if (known == elementIndex.end()) {
+                index = static_cast<std::uint32_t>(elementList.size());
+                elementIndex.emplace(elem, index);
+                elementList.push_back(elem);
+                const Shape* shape = &elem->getShape();
+                if (shapeIndex.find(shape) == shapeIndex.end()) {
+                    shapeIndex.emplace(shape, static_cast<std::uint32_t>(shapeList.size()));
+                    shapeList.push_back(shape);
+                }
+            } else {
+                index = known->second;
+            }
+            putU32(chunk, index);
+            putU32(chunk, static_cast<std::uint32_t>(elemPair.second.first));
+            putU32(chunk, static_cast<std::uint32_t>(elemPair.second.second));
+        }
+        file.write(chunk.data(), chunk.size());
+        offset += chunk.size();
+    }
+
+    // Данные форм выровнены на 8 байт, чтобы слова читались прямо из отображения
+    std::size_t padding = static_cast<std::size_t>((8 - offset % 8) % 8);
+    file.write(std::string(padding, '\0').data(), padding);
+    offset += padding;
+
+    std::vector<std::uint64_t> shapeOffsets;
+    for (const Shape* shape : shapeList) {
+        std::size_t words = planeWords(shape->getWidth(), shape->getHeight());
+        chunk.clear();
+        putPlane(chunk, shape->getOccupancy(), words);
+        putPlane(chunk, shape->getConnectors(), words);
+        putPlane(chunk, shape->getSockets(), words);
+        shapeOffsets.push_back(offset);
+        file.write(chunk.data(), chunk.size());
+        offset += chunk.size();
+    }
+
+    std::uint64_t shapeTableOffset = offset;
+    chunk.clear();
+    for (std::size_t i = 0; i < shapeList.size(); i++) {
+        putU32(chunk, static_cast<std::uint32_t>(shapeList[i]->getWidth()));
+        putU32(chunk, static_cast<std::uint32_t>(shapeList[i]->getHeight()));
+        putU64(chunk, shapeOffsets[i]);
+    }
+    std::uint64_t elementTableOffset = shapeTableOffset + chunk.size();
+    for (const Element* elem : elementList) {
+        putU32(chunk, shapeIndex[&elem->getShape()]);
+        bool isMotor = elem->getType() == ElementType::MOTOR;
+        const Motor* motor = isMotor ? static_cast<const Motor*>(elem) : nullptr;
+        putU32(chunk, isMotor ? 1 : 0);
+        putU32(chunk, static_cast<std::uint32_t>(isMotor ? motor->getSpeed() : 0));
+        chunk.push_back(static_cast<char>(isMotor ? motor->getDirection() : 0));
+        chunk.push_back(static_cast<char>(isMotor && motor->getStatus() ? 1 : 0));
+        chunk.append(2, '\0');
+    }
+    file.write(chunk.data(), chunk.size());
+
+    std::string header(FILE_MAGIC, sizeof(FILE_MAGIC));
+    putU32(header, SCHEME_FILE_VERSION);
+    putU32(header, static_cast<std::uint32_t>(scheme.getLayerCount()));
+    putU32(header, static_cast<std::uint32_t>(shapeList.size()));
+    putU32(header, static_cast<std::uint32_t>(elementList.size()));
+    putU32(header, static_cast<std::uint32_t>(scheme.getIndexType()));
+    putU32(header, 0);
+    putU64(header, shapeTableOffset);
+    putU64(header, elementTableOffset);
+    file.seekp(0);
+    file.write(header.data(), header.size());
+
+    if (!file) {
+        return fail(error, "write error in " + path);
+    }
+    return true;
+}
+
+// Файл, отображенный в память только для чтения
+class MappedFile {
+private:
+    const unsigned char* bytes;
+    std::size_t length;
+#if defined(_WIN32)
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#elif !defined(SCHEMEFILE_MMAP)
+    std::vector<unsigned char> buffer; // без mmap файл читается целиком
+#endif
+
+public:
+    MappedFile() : bytes(nullptr), length(0) {
+#if defined(_WIN32)
+        fileHandle = INVALID_HANDLE_VALUE;
+        mappingHandle = nullptr;
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(_WIN32)
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mappingHandle) CloseHandle(mappingHandle);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+#elif defined(SCHEMEFILE_MMAP)
+        if (bytes) munmap(const_cast<unsigned char*>(bytes), length);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#if defined(_WIN32)
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                 OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0) return false;
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mappingHandle) return false;
+        bytes = static_cast<const unsigned char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+        length = static_cast<std::size_t>(fileSize.QuadPart);
+        return bytes != nullptr;
+#elif defined(SCHEMEFILE_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        bytes = static_cast<const unsigned char*>(mapped);
+        length = static_cast<std::size_t>(info.st_size);
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) return false;
+        buffer.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        bytes = buffer.data();
+        length = buffer.size();
+        return length > 0;
+#endif
+    }
+
+    const unsigned char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+};
+
+// Матрица формы: на little-endian машине - представление поверх файла,
+// иначе слова декодируются в собственную память
+static BitPlane readPlane(const unsigned char* data, std::uint32_t width, std::uint32_t height) {
+    if (hostIsLittleEndian()) {
+        return BitPlane::view(width, height, reinterpret_cast<const std::uint64_t*>(data));
+    }
+    BitPlane plane(width, height);
+    for (std::uint32_t y = 0; y < height && plane.getWordCount() > 0; y++) {
+        std::uint64_t* row = plane.getRow(y);
+        for (int k = 0; k < plane.getWordsPerRow(); k++) {
+            row[k] = getU64(data + 8 * (static_cast<std::size_t>(y) * plane.getWordsPerRow() + k));
+        }
+    }
+    return plane;
+}
+
+// Матрицы формы согласованы: биты за шириной строки нулевые, соединители
+// лежат в занятых клетках, гнезда - занятые клетки без соединителей
+static bool validPlanes(const BitPlane& occupancy, const BitPlane& connectors, const BitPlane& sockets) {
+    int rowWords = occupancy.getWordsPerRow();
+    int tailBits = occupancy.getWidth() % BitPlane::WORD_BITS;
+    std::uint64_t tailMask = tailBits ? (std::uint64_t(1) << tailBits) - 1 : ~std::uint64_t(0);
+    for (int y = 0; y < occupancy.getHeight() && rowWords > 0; y++) {
+        const std::uint64_t* occ = occupancy.getRow(y);
+        const std::uint64_t* conn = connectors.getRow(y);
+        const std::uint64_t* sock = sockets.getRow(y);
+        for (int k = 0; k < rowWords; k++) {
+            if ((conn[k] & ~occ[k]) != 0 || sock[k] != (occ[k] & ~conn[k])) {
+                return false;
+            }
+        }
+        if ((occ[rowWords - 1] & ~tailMask) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadScheme(const std::string& path, Scheme& scheme, std::string* error) {
+    std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+    if (!mapping->open(path)) {
+        return fail(error, "cannot map " + path);
+    }
+    const unsigned char* data = mapping->data();
+    std::size_t size = mapping->size();
+    if (size < HEADER_SIZE || std::memcmp(data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        return fail(error, path + " is not a scheme file");
+    }
+    if (getU32(data + 8) != SCHEME_FILE_VERSION) {
+        return fail(error, "unsupported scheme file version");
+    }
+    std::uint32_t layerCount = getU32(data + 12);
+    std::uint32_t shapeCount = getU32(data + 16);
+    std::uint32_t elementCount = getU32(data + 20);
+    std::uint32_t indexType = getU32(data + 24);
+    std::uint64_t shapeTableOffset = getU64(data + 32);
+    std::uint64_t elementTableOffset = getU64(data + 40);
+    if (shapeTableOffset > size || (size - shapeTableOffset) / SHAPE_ENTRY_SIZE < shapeCount ||
+        elementTableOffset > size || (size - elementTableOffset) / ELEMENT_ENTRY_SIZE < elementCount ||
+        indexType > static_cast<std::uint32_t>(SpatialIndexType::GRID)) {
+        return fail(error, "corrupt scheme header");
+    }
+
+    // Формы смотрят в отображение и держат его, пока живы
+    std::shared_ptr<const void> storage(mapping, mapping->data());
+    std::vector<std::shared_ptr<const Shape>> shapes;
+    shapes.reserve(shapeCount);
+    for (std::uint32_t i = 0; i < shapeCount; i++) {
+        const unsigned char* entry = data + shapeTableOffset + i * SHAPE_ENTRY_SIZE;
+        std::uint32_t width = getU32(entry);
+        std::uint32_t height = getU32(entry + 4);
+        std::uint64_t dataOffset = getU64(entry + 8);
+        std::size_t words = planeWords(width, height);
+        if (width > 0x7FFFFFFF || height > 0x7FFFFFFF || dataOffset % 8 != 0 ||
+            dataOffset > size || (size - dataOffset) / 24 < words) {
+            return fail(error, "corrupt shape table");
+        }
+        const unsigned char* planes = data + dataOffset;
+        BitPlane occupancy = readPlane(planes, width, height);
+        BitPlane connectors = readPlane(planes + 8 * words, width, height);
+        BitPlane sockets = readPlane(planes + 16 * words, width, height);
+        if (!validPlanes(occupancy, connectors, sockets)) {
+            return fail(error, "corrupt shape table");
+        }
+        shapes.push_back(ShapeRegistry::instance().intern(width, height, occupancy, connectors, sockets, storage));
+    }
+
+    Scheme loaded(std::make_shared<ElementStore>(), static_cast<SpatialIndexType>(indexType));
+    std::vector<Element*> elements;
+    elements.reserve(elementCount);
+    for (std::uint32_t i = 0; i < elementCount; i++) {
+        const unsigned char* entry = data + elementTableOffset + i * ELEMENT_ENTRY_SIZE;
+        std::uint32_t shape = getU32(entry);
+        if (shape >= shapeCount) {
+            return fail(error, "corrupt element table");
+        }
+        if (getU32(entry + 4) == 1) {
+            std::uint32_t speed = getU32(entry + 8);
+            if (speed > 100 || entry[12] > 2) {
+                return fail(error, "corrupt element table");
+            }
+            Motor* motor = static_cast<Motor*>(loaded.getElement(
+                loaded.getElementStore()->createMotor(shapes[shape], static_cast<int>(speed), entry[12])));
+            motor->setStatus(entry[13] != 0);
+            elements.push_back(motor);
+        } else {
+            elements.push_back(loaded.getElement(loaded.getElementStore()->createElement(shapes[shape])));
+        }
+    }
+
+    std::size_t offset = HEADER_SIZE;
+    std::vector<std::pair<Element*, std::pair<int, int>>> items;
+    std::vector<PlacementStatus> statuses;
+    for (std::uint32_t i = 0; i < layerCount; i++) {
+        if (size - offset < 4) {
+            return fail(error, "truncated layer data");
+        }
+        std::uint32_t count = getU32(data + offset);
+        offset += 4;
+        if ((size - offset) / PLACEMENT_SIZE < count) {
+            return fail(error, "truncated layer data");
+        }
+        items.clear();
+        for (std::uint32_t k = 0; k < count; k++, offset += PLACEMENT_SIZE) {
+            std::uint32_t elem = getU32(data + offset);
+            if (elem >= elementCount) {
+                return fail(error, "corrupt placement");
+            }
+            int x = getI32(data + offset + 4);
+            int y = getI32(data + offset + 8);
+            if (!Layer::fitsCoordinates(x, y, elements[elem]->getWidth(), elements[elem]->getHeight())) {
+                return fail(error, "corrupt placement");
+            }
+            items.push_back(std::make_pair(elements[elem], std::make_pair(x, y)));
+        }
+        statuses.assign(items.size(), PlacementStatus::PLACED);
+        int layerIndex = loaded.createLayer();
+        if (loaded.getLayer(layerIndex)->placeElements(items, statuses) != static_cast<int>(items.size())) {
+            return fail(error, "overlapping elements in layer " + std::to_string(i));
+        }
+    }
+
+    // Загруженная схема - начальное состояние: создание слоев не отменяется
+    loaded.clearHistory();
+    scheme.swap(loaded);
+    return true;
+}
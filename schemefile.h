@@ -0,0 +1,27 @@
+// schemefile.h
+#ifndef SCHEMEFILE_H
+#define SCHEMEFILE_H
+
+#include "scheme.h"
+#include <cstdint>
+#include <string>
+
+// Двоичный формат схемы (все числа little-endian):
+//   заголовок (48 байт): "CNSTRSCH", версия, число слоев, форм, элементов,
+//                        тип индекса, резерв, смещения таблиц форм и элементов;
+//   слои: для каждого - число размещений и записи (элемент, x, y) по 12 байт;
+//   данные форм (выровнены на 8): слова occupancy, connectors, sockets;
+//   таблица форм: ширина, высота, смещение данных (16 байт на форму);
+//   таблица элементов: форма, тип, скорость, направление, состояние (16 байт).
+// Слои пишутся за один проход, таблицы - после них.
+
+const std::uint32_t SCHEME_FILE_VERSION = 1;
+
+// Сохраняет слои, размещенные элементы, их формы и состояние моторов
+bool saveScheme(const Scheme& scheme, const std::string& path, std::string* error = nullptr);
+
+// Загружает схему из файла. Файл отображается в память, и формы
+// смотрят прямо в отображение, без копирования матриц.
+bool loadScheme(const std::string& path, Scheme& scheme, std::string* error = nullptr);
+
+#endif // SCHEMEFILE_H
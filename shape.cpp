@@ -0,0 +1,157 @@
+// shape.cpp
+#include "shape.h"
+#include <cstdint>
+#include <utility>
+
+// Shape
+
+Shape::Shape(int shapeId, int w, int h, BitPlane occ, BitPlane conn, BitPlane sock,
+             std::size_t shapeHash, std::shared_ptr<const void> storage)
+    : id(shapeId), width(w), height(h), occupancy(std::move(occ)),
+      connectors(std::move(conn)), sockets(std::move(sock)), hash(shapeHash),
+      backing(std::move(storage)) {}
+
+BitPlane Shape::computeSockets(const BitPlane& occ, const BitPlane& conn) {
+    BitPlane result(occ);
+    for (int y = 0; y < result.getHeight(); y++) {
+        std::uint64_t* socketRow = result.getRow(y);
+        const std::uint64_t* connectorRow = conn.getRow(y);
+        for (int k = 0; k < result.getWordsPerRow(); k++) {
+            socketRow[k] &= ~connectorRow[k];
+        }
+    }
+    return result;
+}
+
+BitPlane Shape::orientPlane(const BitPlane& plane, Orientation o) {
+    int w = plane.getWidth();
+    int h = plane.getHeight();
+    int turns = static_cast<int>(o) % 4;
+    bool flip = static_cast<int>(o) >= 4;
+    BitPlane result = (turns % 2 == 0) ? BitPlane(w, h) : BitPlane(h, w);
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (!plane.get(x, y)) continue;
+            int px = flip ? w - 1 - x : x;
+            int py = y;
+            int pw = w;
+            int ph = h;
+            // Поворот на 90 по часовой: (x, y) -> (h - 1 - y, x)
+            for (int t = 0; t < turns; t++) {
+                int turnedX = ph - 1 - py;
+                py = px;
+                px = turnedX;
+                std::swap(pw, ph);
+            }
+            result.set(px, py, true);
+        }
+    }
+    return result;
+}
+
+std::shared_ptr<const Shape> Shape::getOriented(Orientation o) const {
+    if (o == Orientation::R0) {
+        return shared_from_this();
+    }
+    int slot = static_cast<int>(o);
+    std::lock_guard<std::mutex> lock(orientationMutex);
+    std::shared_ptr<const Shape> cached = orientations[slot].lock();
+    if (!cached) {
+        BitPlane occ = orientPlane(occupancy, o);
+        BitPlane conn = orientPlane(connectors, o);
+        cached = ShapeRegistry::instance().intern(occ.getWidth(), occ.getHeight(), occ, conn);
+        orientations[slot] = cached;
+    }
+    return cached;
+}
+
+int Shape::getId() const { return id; }
+int Shape::getWidth() const { return width; }
+int Shape::getHeight() const { return height; }
+const BitPlane& Shape::getOccupancy() const { return occupancy; }
+const BitPlane& Shape::getConnectors() const { return connectors; }
+const BitPlane& Shape::getSockets() const { return sockets; }
+std::size_t Shape::getHash() const { return hash; }
+
+std::size_t Shape::getMemoryUsage() const {
+    return sizeof(Shape) + occupancy.getMemoryUsage() + connectors.getMemoryUsage() +
+           sockets.getMemoryUsage();
+}
+
+bool Shape::isMapped() const {
+    return backing != nullptr;
+}
+
+bool Shape::sameCells(int w, int h, const BitPlane& occ, const BitPlane& conn) const {
+    return width == w && height == h && occupancy == occ && connectors == conn;
+}
+
+std::size_t Shape::computeHash(int w, int h, const BitPlane& occ, const BitPlane& conn) {
+    // FNV-1a по размерам и словам обеих матриц
+    std::uint64_t value = 1469598103934665603ull;
+    auto mix = [&value](std::uint64_t word) {
+        value ^= word;
+        value *= 1099511628211ull;
+    };
+    mix(static_cast<std::uint64_t>(w));
+    mix(static_cast<std::uint64_t>(h));
+    for (std::size_t i = 0; i < occ.getWordCount(); i++) mix(occ.getData()[i]);
+    for (std::size_t i = 0; i < conn.getWordCount(); i++) mix(conn.getData()[i]);
+    return static_cast<std::size_t>(value);
+}
+
+// ShapeRegistry
+
+ShapeRegistry::ShapeRegistry() : nextId(0) {}
+
+ShapeRegistry& ShapeRegistry::instance() {
+    static ShapeRegistry registry;
+    return registry;
+}
+
+std::shared_ptr<const Shape> ShapeRegistry::intern(int w, int h, const BitPlane& occ, const BitPlane& conn) {
+    return intern(w, h, occ, conn, Shape::computeSockets(occ, conn), nullptr);
+}
+
+std::shared_ptr<const Shape> ShapeRegistry::intern(int w, int h, const BitPlane& occ, const BitPlane& conn,
+                                                   const BitPlane& sock, std::shared_ptr<const void> storage) {
+    std::size_t hash = Shape::computeHash(w, h, occ, conn);
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto range = shapes.equal_range(hash);
+    for (auto it = range.first; it != range.second;) {
+        std::shared_ptr<const Shape> existing = it->second.lock();
+        if (!existing) {
+            it = shapes.erase(it); // форма больше никем не используется
+            continue;
+        }
+        if (existing->sameCells(w, h, occ, conn)) {
+            return existing;
+        }
+        ++it;
+    }
+
+    // Матрицы-представления переносятся как есть, без копирования слов
+    auto keep = [&storage](const BitPlane& plane) {
+        return storage ? BitPlane::view(plane.getWidth(), plane.getHeight(), plane.getData())
+                       : BitPlane(plane);
+    };
+    std::shared_ptr<const Shape> created = std::make_shared<const Shape>(
+        nextId++, w, h, keep(occ), keep(conn), keep(sock), hash, storage);
+    shapes.emplace(hash, created);
+    return created;
+}
+
+std::size_t ShapeRegistry::getShapeCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::size_t alive = 0;
+    for (auto it = shapes.begin(); it != shapes.end();) {
+        if (it->second.expired()) {
+            it = shapes.erase(it);
+        } else {
+            alive++;
+            ++it;
+        }
+    }
+    return alive;
+}
@@ -0,0 +1,90 @@
+// shape.h
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include "bitplane.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Восемь ориентаций элемента: поворот по часовой стрелке на 0/90/180/270
+// градусов, в FLIP_* - после отражения слева направо
+enum class Orientation
+{
+    R0,
+    R90,
+    R180,
+    R270,
+    FLIP_R0,
+    FLIP_R90,
+    FLIP_R180,
+    FLIP_R270,
+};
+
+const int ORIENTATION_COUNT = 8;
+
+// Неизменяемая форма элемента. Одинаковые формы хранятся один раз
+// (см. ShapeRegistry), поэтому элементы одной формы указывают на один объект.
+class Shape : public std::enable_shared_from_this<Shape> {
+private:
+    int id;
+    int width;
+    int height;
+    BitPlane occupancy;
+    BitPlane connectors;
+    BitPlane sockets; // occupancy & ~connectors, считается один раз
+    std::size_t hash;
+    // Владелец внешней памяти, если матрицы смотрят в нее (отображенный файл)
+    std::shared_ptr<const void> backing;
+    // Повернутые варианты: считаются один раз, пока их кто-то использует.
+    // Слабые ссылки - вариант варианта может оказаться этой же формой
+    mutable std::mutex orientationMutex;
+    mutable std::weak_ptr<const Shape> orientations[ORIENTATION_COUNT];
+
+public:
+    Shape(int shapeId, int w, int h, BitPlane occ, BitPlane conn, BitPlane sock,
+          std::size_t shapeHash, std::shared_ptr<const void> storage = nullptr);
+
+    int getId() const;
+    int getWidth() const;
+    int getHeight() const;
+    const BitPlane& getOccupancy() const;
+    const BitPlane& getConnectors() const;
+    const BitPlane& getSockets() const;
+    std::size_t getHash() const;
+    bool sameCells(int w, int h, const BitPlane& occ, const BitPlane& conn) const;
+
+    // Форма в ориентации o (общая с другими формами с теми же клетками)
+    std::shared_ptr<const Shape> getOriented(Orientation o) const;
+
+    bool isMapped() const; // матрицы лежат во внешней памяти
+    std::size_t getMemoryUsage() const;
+
+    static std::size_t computeHash(int w, int h, const BitPlane& occ, const BitPlane& conn);
+    static BitPlane computeSockets(const BitPlane& occ, const BitPlane& conn);
+    static BitPlane orientPlane(const BitPlane& plane, Orientation o);
+};
+
+// Реестр форм: по матрицам возвращает общий экземпляр Shape.
+// Формы, на которые никто не ссылается, освобождаются автоматически.
+class ShapeRegistry {
+private:
+    std::mutex mutex;
+    std::unordered_multimap<std::size_t, std::weak_ptr<const Shape>> shapes;
+    int nextId;
+
+    ShapeRegistry();
+
+public:
+    static ShapeRegistry& instance();
+
+    std::shared_ptr<const Shape> intern(int w, int h, const BitPlane& occ, const BitPlane& conn);
+    // Регистрирует форму поверх внешних матриц без копирования;
+    // storage держит эту память, пока форма жива
+    std::shared_ptr<const Shape> intern(int w, int h, const BitPlane& occ, const BitPlane& conn,
+                                        const BitPlane& sock, std::shared_ptr<const void> storage);
+    std::size_t getShapeCount(); // число живых форм
+};
+
+#endif // SHAPE_H
@@ -0,0 +1,203 @@
+// simulation.cpp
+#include "simulation.h"
+#include "connectivity.h"
+#include <algorithm>
+
+// 1 об/мин = 6 градусов в секунду
+static const float DEGREES_PER_RPM_SECOND = 6.0f;
+
+MotorSimulation::MotorSimulation(const Scheme& scheme, double secondsPerTick)
+    : timestep(secondsPerTick > 0 ? secondsPerTick : 1.0 / 60), tickCount(0) {
+    rebuild(scheme);
+}
+
+void MotorSimulation::rebuild(const Scheme& scheme) {
+    layerOffsets.assign(1, 0);
+    motors.clear();
+    motorNodes.clear();
+    for (int l = 0; l < scheme.getLayerCount(); l++) {
+        const auto& elements = scheme.getLayer(l)->getElements();
+        for (std::size_t i = 0; i < elements.size(); i++) {
+            if (elements[i].first->getType() == ElementType::MOTOR) {
+                motors.push_back(static_cast<Motor*>(elements[i].first));
+                motorNodes.push_back(layerOffsets.back() + static_cast<int>(i));
+            }
+        }
+        layerOffsets.push_back(layerOffsets.back() + static_cast<int>(elements.size()));
+    }
+    int nodes = layerOffsets.back();
+
+    // CSR из списка соединений: сначала степени, затем раскладка
+    std::vector<ElementLink> links;
+    scheme.getConnections(links);
+    adjacencyStart.assign(nodes + 1, 0);
+    for (const ElementLink& link : links) {
+        adjacencyStart[nodeOf(link.upperLayer, link.upperElement) + 1]++;
+        adjacencyStart[nodeOf(link.upperLayer - 1, link.lowerElement) + 1]++;
+    }
+    for (int i = 0; i < nodes; i++) {
+        adjacencyStart[i + 1] += adjacencyStart[i];
+    }
+    adjacency.assign(adjacencyStart.back(), 0);
+    std::vector<int> filled(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (const ElementLink& link : links) {
+        int upper = nodeOf(link.upperLayer, link.upperElement);
+        int lower = nodeOf(link.upperLayer - 1, link.lowerElement);
+        adjacency[filled[upper]++] = lower;
+        adjacency[filled[lower]++] = upper;
+    }
+
+    angle.assign(nodes, 0.0f);
+    tickCount = 0;
+    propagate();
+}
+
+int MotorSimulation::nodeOf(int layerIndex, int elementIndex) const {
+    if (layerIndex < 0 || layerIndex + 1 >= static_cast<int>(layerOffsets.size()) || elementIndex < 0) {
+        return -1;
+    }
+    int node = layerOffsets[layerIndex] + elementIndex;
+    return node < layerOffsets[layerIndex + 1] ? node : -1;
+}
+
+void MotorSimulation::jamComponent(int start) {
+    if (jammed[start]) return;
+    std::vector<int> stack(1, start);
+    jammed[start] = 1;
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+        speed[node] = 0.0f;
+        direction[node] = 0;
+        rate[node] = 0.0f;
+        for (int e = adjacencyStart[node]; e < adjacencyStart[node + 1]; e++) {
+            int next = adjacency[e];
+            if (!jammed[next]) {
+                jammed[next] = 1;
+                stack.push_back(next);
+            }
+        }
+    }
+}
+
+void MotorSimulation::propagate() {
+    int nodes = layerOffsets.back();
+    speed.assign(nodes, 0.0f);
+    direction.assign(nodes, 0);
+    rate.assign(nodes, 0.0f);
+    driver.assign(nodes, -1);
+    jammed.assign(nodes, 0);
+    conflicts.clear();
+
+    // Обход в ширину сразу от всех работающих моторов
+    std::vector<int> queue;
+    queue.reserve(nodes);
+    for (std::size_t m = 0; m < motors.size(); m++) {
+        const Motor* motor = motors[m];
+        int dir = motor->getDirection();
+        if (!motor->getStatus() || motor->getSpeed() <= 0 || (dir != 1 && dir != 2)) continue;
+        int node = motorNodes[m];
+        speed[node] = static_cast<float>(motor->getSpeed());
+        direction[node] = static_cast<std::int8_t>(dir);
+        driver[node] = static_cast<int>(m);
+        queue.push_back(node);
+    }
+    std::vector<int> conflictNodes;
+    for (std::size_t head = 0; head < queue.size(); head++) {
+        int node = queue[head];
+        std::int8_t expected = static_cast<std::int8_t>(3 - direction[node]);
+        for (int e = adjacencyStart[node]; e < adjacencyStart[node + 1]; e++) {
+            int next = adjacency[e];
+            if (driver[next] < 0) {
+                speed[next] = speed[node];
+                direction[next] = expected;
+                driver[next] = driver[node];
+                queue.push_back(next);
+            } else if ((direction[next] != expected || speed[next] != speed[node]) && node < next) {
+                // Ребро видно с обеих сторон - записываем один раз
+                int layer = static_cast<int>(std::upper_bound(layerOffsets.begin(), layerOffsets.end(), next) -
+                                             layerOffsets.begin()) - 1;
+                conflicts.push_back(SimulationConflict{layer, next - layerOffsets[layer],
+                                                       driver[node], driver[next]});
+                conflictNodes.push_back(next);
+            }
+        }
+    }
+    for (int node : conflictNodes) {
+        jamComponent(node);
+    }
+    for (int i = 0; i < nodes; i++) {
+        float sign = direction[i] == 1 ? 1.0f : (direction[i] == 2 ? -1.0f : 0.0f);
+        rate[i] = sign * speed[i] * DEGREES_PER_RPM_SECOND;
+    }
+}
+
+void MotorSimulation::tick() {
+    float dt = static_cast<float>(timestep);
+    std::size_t nodes = angle.size();
+    float* angles = angle.data();
+    const float* rates = rate.data();
+    // Без ветвлений и вызовов - цикл векторизуется
+    for (std::size_t i = 0; i < nodes; i++) {
+        float value = angles[i] + rates[i] * dt;
+        value -= 360.0f * static_cast<float>(static_cast<int>(value * (1.0f / 360.0f)));
+        value += value < 0.0f ? 360.0f : 0.0f;
+        angles[i] = value;
+    }
+    tickCount++;
+}
+
+void MotorSimulation::run(int ticks) {
+    for (int t = 0; t < ticks; t++) {
+        tick();
+    }
+}
+
+int MotorSimulation::getNodeCount() const {
+    return layerOffsets.back();
+}
+
+int MotorSimulation::getMotorCount() const {
+    return static_cast<int>(motors.size());
+}
+
+long MotorSimulation::getTickCount() const {
+    return tickCount;
+}
+
+double MotorSimulation::getTime() const {
+    return tickCount * timestep;
+}
+
+double MotorSimulation::getTimestep() const {
+    return timestep;
+}
+
+float MotorSimulation::getSpeed(int layerIndex, int elementIndex) const {
+    int node = nodeOf(layerIndex, elementIndex);
+    return node < 0 ? 0.0f : speed[node];
+}
+
+int MotorSimulation::getDirection(int layerIndex, int elementIndex) const {
+    int node = nodeOf(layerIndex, elementIndex);
+    return node < 0 ? 0 : direction[node];
+}
+
+float MotorSimulation::getAngle(int layerIndex, int elementIndex) const {
+    int node = nodeOf(layerIndex, elementIndex);
+    return node < 0 ? 0.0f : angle[node];
+}
+
+bool MotorSimulation::isDriven(int layerIndex, int elementIndex) const {
+    int node = nodeOf(layerIndex, elementIndex);
+    return node >= 0 && driver[node] >= 0 && !jammed[node];
+}
+
+bool MotorSimulation::isJammed(int layerIndex, int elementIndex) const {
+    int node = nodeOf(layerIndex, elementIndex);
+    return node >= 0 && jammed[node];
+}
+
+const std::vector<SimulationConflict>& MotorSimulation::getConflicts() const {
+    return conflicts;
+}
@@ -0,0 +1,72 @@
+// simulation.h
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include "element.h"
+#include "scheme.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Столкновение приводов: узел получил от разных моторов разное вращение
+struct SimulationConflict {
+    int layerIndex;
+    int elementIndex;
+    int firstMotor;  // номера моторов в getMotorCount() (по порядку слоев)
+    int secondMotor;
+};
+
+// Симуляция с фиксированным шагом. Узлы - все элементы схемы (слой за слоем),
+// ребра - соединения слоев. Работающий мотор вращает соединенные с ним
+// элементы с той же скоростью, каждое звено цепи - в обратную сторону.
+// Компонента, в которую приводы передают разное вращение, заклинивает.
+// Состояние лежит в отдельных массивах, шаг - один проход по ним.
+class MotorSimulation {
+private:
+    double timestep; // секунд на шаг
+    long tickCount;
+
+    std::vector<int> layerOffsets; // первый узел каждого слоя, в конце - число узлов
+    std::vector<Motor*> motors;
+    std::vector<int> motorNodes;
+
+    // Смежность в формате CSR: соседи узла i - adjacency[adjacencyStart[i]..adjacencyStart[i + 1])
+    std::vector<int> adjacencyStart;
+    std::vector<int> adjacency;
+
+    std::vector<float> speed;            // об/мин
+    std::vector<std::int8_t> direction;  // 0 - стоит, 1 - по часовой, 2 - против
+    std::vector<float> rate;             // градусов в секунду, по часовой - положительно
+    std::vector<float> angle;            // градусы [0, 360)
+    std::vector<int> driver;             // номер ведущего мотора, -1
+    std::vector<std::uint8_t> jammed;
+    std::vector<SimulationConflict> conflicts;
+
+    int nodeOf(int layerIndex, int elementIndex) const; // -1, если нет
+    void jamComponent(int node);
+
+public:
+    explicit MotorSimulation(const Scheme& scheme, double secondsPerTick = 1.0 / 60);
+
+    // Заново читает схему (элементы, соединения, моторы); углы сбрасываются
+    void rebuild(const Scheme& scheme);
+    // Заново читает состояние моторов и распространяет вращение
+    void propagate();
+    void tick();
+    void run(int ticks);
+
+    int getNodeCount() const;
+    int getMotorCount() const;
+    long getTickCount() const;
+    double getTime() const; // секунд с начала
+    double getTimestep() const;
+
+    float getSpeed(int layerIndex, int elementIndex) const;
+    int getDirection(int layerIndex, int elementIndex) const;
+    float getAngle(int layerIndex, int elementIndex) const;
+    bool isDriven(int layerIndex, int elementIndex) const;
+    bool isJammed(int layerIndex, int elementIndex) const;
+    const std::vector<SimulationConflict>& getConflicts() const;
+};
+
+#endif // SIMULATION_H
@@ -0,0 +1,275 @@
+// solver.cpp
+#include "solver.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+
+struct AssemblySolver::Node {
+    std::shared_ptr<const Node> parent;
+    Placement placement;
+};
+
+struct AssemblySolver::State {
+    std::vector<Layer> layers; // копии слоев разделяют содержимое с родителем
+    std::vector<int> remaining;
+    int placed;
+    int connectors;
+    int remainingPieces;
+    int remainingConnectors;
+    std::int64_t value;
+    std::uint64_t signature; // XOR хэшей размещений: не зависит от их порядка
+    std::shared_ptr<const Node> node;
+};
+
+// Ход из состояния stateIndex; само состояние строится, только если ход
+// попадет в следующий луч
+struct AssemblySolver::Child {
+    std::size_t stateIndex;
+    std::size_t sequence; // порядок хода внутри состояния
+    int piece;
+    int layerIndex;
+    int x;
+    int y;
+    std::int64_t value;
+    std::int64_t bound;
+    std::uint64_t signature;
+};
+
+struct AssemblySolver::Incumbent {
+    std::atomic<std::int64_t> value; // для отсечения без блокировки
+    std::mutex mutex;
+    std::int64_t recordedValue;
+    std::shared_ptr<const Node> node;
+    int layerCount;
+    int placed;
+    int connectors;
+};
+
+static std::uint64_t mixHash(std::uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+static std::uint64_t placementHash(int piece, int layerIndex, int x, int y) {
+    std::uint64_t key = static_cast<std::uint32_t>(x) |
+                        (static_cast<std::uint64_t>(static_cast<std::uint32_t>(y)) << 32);
+    return mixHash(key ^ mixHash((static_cast<std::uint64_t>(piece) << 16) | static_cast<std::uint16_t>(layerIndex)));
+}
+
+SolverOptions::SolverOptions()
+    : goal(SolverGoal::MAX_CONNECTIONS), beamWidth(32), candidatesPerMove(8), maxLayers(8),
+      timeBudget(1000) {}
+
+bool SolverResult::buildScheme(Scheme& scheme) const {
+    if (scheme.getLayerCount() != 0) {
+        return false;
+    }
+    for (int i = 0; i < layerCount; i++) {
+        scheme.createLayer();
+    }
+    return scheme.addElements(placements);
+}
+
+AssemblySolver::AssemblySolver(const std::vector<SolverPiece>& bag, const Rect& area,
+                               const SolverOptions& solverOptions)
+    : footprint(area), options(solverOptions), totalPieces(0), totalConnectors(0) {
+    options.beamWidth = std::max(options.beamWidth, 1);
+    options.candidatesPerMove = std::max(options.candidatesPerMove, 1);
+    options.maxLayers = std::max(options.maxLayers, 1);
+    for (const SolverPiece& piece : bag) {
+        if (!piece.elem || piece.count <= 0) continue;
+        pieces.push_back(piece);
+        int connectors = 0;
+        const BitPlane& plane = piece.elem->getConnectors();
+        for (std::size_t i = 0; i < plane.getWordCount(); i++) {
+            connectors += __builtin_popcountll(plane.getData()[i]);
+        }
+        pieceConnectors.push_back(connectors);
+        totalPieces += piece.count;
+        totalConnectors += piece.count * connectors;
+    }
+}
+
+// Ценность - одно число: главный критерий цели, затем второстепенный
+std::int64_t AssemblySolver::valueOf(int placed, int connectors, int layerCount) const {
+    if (options.goal == SolverGoal::MAX_CONNECTIONS) {
+        return static_cast<std::int64_t>(connectors) * (totalPieces + 1) + placed;
+    }
+    return static_cast<std::int64_t>(placed) * (options.maxLayers + 1) + (options.maxLayers - layerCount);
+}
+
+// Оценка сверху: все оставшиеся детали встают без новых слоев,
+// и все их соединители стоят на гнездах
+std::int64_t AssemblySolver::boundOf(const State& state) const {
+    return valueOf(state.placed + state.remainingPieces, state.connectors + state.remainingConnectors,
+                   static_cast<int>(state.layers.size()));
+}
+
+void AssemblySolver::expand(const State& state, std::size_t stateIndex, std::vector<Child>& out,
+                            Incumbent& best, std::chrono::steady_clock::time_point deadline) const {
+    if (boundOf(state) <= best.value.load(std::memory_order_relaxed)) {
+        return;
+    }
+    int layerCount = static_cast<int>(state.layers.size());
+    // Новый слой открывается только над непустым верхним
+    bool canOpenLayer = layerCount < options.maxLayers && !state.layers.back().isEmpty();
+    Layer emptyLayer;
+    std::vector<std::pair<int, int>> positions;
+    std::size_t sequence = 0;
+
+    for (std::size_t p = 0; p < pieces.size(); p++) {
+        if (state.remaining[p] == 0) continue;
+        if (std::chrono::steady_clock::now() >= deadline) return;
+        Element* elem = pieces[p].elem;
+        Rect region = {footprint.x, footprint.y,
+                       footprint.width - elem->getWidth() + 1, footprint.height - elem->getHeight() + 1};
+        if (region.width <= 0 || region.height <= 0) continue;
+
+        for (int l = 0; l < layerCount + (canOpenLayer ? 1 : 0); l++) {
+            int placed = state.placed + 1;
+            int connectors = state.connectors + (l > 0 ? pieceConnectors[p] : 0);
+            int childLayers = std::max(layerCount, l + 1);
+            std::int64_t value = valueOf(placed, connectors, childLayers);
+            // Соединители детали на нижнем слое пропадают, новый слой не вернуть
+            std::int64_t bound = valueOf(state.placed + state.remainingPieces,
+                                         connectors + state.remainingConnectors - pieceConnectors[p],
+                                         childLayers);
+            if (bound <= best.value.load(std::memory_order_relaxed)) continue;
+
+            const Layer& target = l < layerCount ? state.layers[l] : emptyLayer;
+            const Layer* lower = l > 0 ? &state.layers[l - 1] : nullptr;
+            positions.clear();
+            target.findPlacements(elem, region, lower, positions, options.candidatesPerMove);
+
+            for (const auto& position : positions) {
+                std::uint64_t signature =
+                    state.signature ^ placementHash(static_cast<int>(p), l, position.first, position.second);
+                out.push_back(Child{stateIndex, sequence++, static_cast<int>(p), l,
+                                    position.first, position.second, value, bound, signature});
+            }
+            if (positions.empty() || value <= best.value.load(std::memory_order_relaxed)) continue;
+
+            // Ход лучше общего рекорда: запоминаем его сразу, не дожидаясь конца шага
+            std::int64_t seen = best.value.load();
+            while (value > seen && !best.value.compare_exchange_weak(seen, value)) {
+            }
+            std::lock_guard<std::mutex> lock(best.mutex);
+            if (value > best.recordedValue) {
+                best.recordedValue = value;
+                best.node = std::make_shared<const Node>(Node{state.node,
+                    Placement{elem, l, positions[0].first, positions[0].second}});
+                best.layerCount = childLayers;
+                best.placed = placed;
+                best.connectors = connectors;
+            }
+        }
+    }
+}
+
+SolverResult AssemblySolver::solve(ThreadPool& pool) const {
+    auto deadline = std::chrono::steady_clock::now() + options.timeBudget;
+
+    std::vector<State> beam(1);
+    State& root = beam[0];
+    root.layers.push_back(Layer());
+    for (const SolverPiece& piece : pieces) root.remaining.push_back(piece.count);
+    root.placed = 0;
+    root.connectors = 0;
+    root.remainingPieces = totalPieces;
+    root.remainingConnectors = totalConnectors;
+    root.value = valueOf(0, 0, 1);
+    root.signature = 0;
+
+    Incumbent best;
+    best.value = root.value;
+    best.recordedValue = root.value;
+    best.layerCount = 1;
+    best.placed = 0;
+    best.connectors = 0;
+    std::int64_t optimum = boundOf(root);
+    std::atomic<std::size_t> expanded(0);
+
+    bool timedOut = false;
+    std::vector<std::vector<Child>> children;
+    std::vector<Child> candidates;
+    while (!beam.empty() && best.value.load() < optimum) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            timedOut = true;
+            break;
+        }
+        // Каждое состояние луча - отдельная задача; потоки пула крадут их друг у друга
+        children.assign(beam.size(), std::vector<Child>());
+        for (std::size_t s = 0; s < beam.size(); s++) {
+            pool.submit([this, s, &beam, &children, &best, &expanded, deadline]() {
+                expand(beam[s], s, children[s], best, deadline);
+                expanded++;
+            });
+        }
+        pool.wait();
+
+        // Следующий луч: лучшие ходы, одинаковые наборы размещений - один раз
+        candidates.clear();
+        std::int64_t threshold = best.value.load();
+        for (const std::vector<Child>& stateChildren : children) {
+            for (const Child& child : stateChildren) {
+                if (child.bound > threshold) candidates.push_back(child);
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Child& a, const Child& b) {
+            if (a.value != b.value) return a.value > b.value;
+            if (a.bound != b.bound) return a.bound > b.bound;
+            if (a.stateIndex != b.stateIndex) return a.stateIndex < b.stateIndex;
+            return a.sequence < b.sequence;
+        });
+        std::vector<const Child*> selected;
+        std::unordered_set<std::uint64_t> signatures;
+        for (const Child& child : candidates) {
+            if (selected.size() >= static_cast<std::size_t>(options.beamWidth)) break;
+            if (signatures.insert(child.signature).second) selected.push_back(&child);
+        }
+
+        std::vector<State> next(selected.size());
+        for (std::size_t i = 0; i < selected.size(); i++) {
+            pool.submit([this, i, &beam, &next, &selected]() {
+                const Child& child = *selected[i];
+                const State& parent = beam[child.stateIndex];
+                State& state = next[i];
+                Element* elem = pieces[child.piece].elem;
+                state.layers = parent.layers;
+                if (child.layerIndex == static_cast<int>(state.layers.size())) {
+                    state.layers.push_back(Layer());
+                }
+                state.layers[child.layerIndex].placeElement(elem, child.x, child.y);
+                state.remaining = parent.remaining;
+                state.remaining[child.piece]--;
+                state.placed = parent.placed + 1;
+                state.connectors = parent.connectors + (child.layerIndex > 0 ? pieceConnectors[child.piece] : 0);
+                state.remainingPieces = parent.remainingPieces - 1;
+                state.remainingConnectors = parent.remainingConnectors - pieceConnectors[child.piece];
+                state.value = child.value;
+                state.signature = child.signature;
+                state.node = std::make_shared<const Node>(Node{parent.node,
+                    Placement{elem, child.layerIndex, child.x, child.y}});
+            });
+        }
+        pool.wait();
+        beam.swap(next);
+    }
+    if (!timedOut && std::chrono::steady_clock::now() >= deadline && best.value.load() < optimum) {
+        timedOut = true;
+    }
+
+    SolverResult result;
+    for (const Node* node = best.node.get(); node; node = node->parent.get()) {
+        result.placements.push_back(node->placement);
+    }
+    std::reverse(result.placements.begin(), result.placements.end());
+    result.layerCount = best.layerCount;
+    result.piecesPlaced = best.placed;
+    result.connectorsUsed = best.connectors;
+    result.timedOut = timedOut;
+    result.statesExpanded = expanded.load();
+    return result;
+}
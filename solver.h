@@ -0,0 +1,82 @@
+// solver.h
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include "element.h"
+#include "layer.h"
+#include "scheme.h"
+#include "threadpool.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Что оптимизирует сборка
+enum class SolverGoal
+{
+    MAX_CONNECTIONS, // больше соединителей, стоящих на гнездах
+    MIN_LAYERS,      // больше деталей, а при равенстве - меньше слоев
+};
+
+// Деталь из набора и сколько таких есть
+struct SolverPiece {
+    Element* elem;
+    int count;
+};
+
+struct SolverOptions {
+    SolverGoal goal;
+    int beamWidth;         // состояний на каждом шаге поиска
+    int candidatesPerMove; // позиций на одну пару (деталь, слой)
+    int maxLayers;
+    std::chrono::milliseconds timeBudget;
+
+    SolverOptions();
+};
+
+struct SolverResult {
+    std::vector<Placement> placements;
+    int layerCount;
+    int piecesPlaced;
+    int connectorsUsed;
+    bool timedOut;    // поиск остановлен бюджетом времени
+    std::size_t statesExpanded;
+
+    // Строит решение в пустой схеме (создает слои); false, если схема не пуста
+    bool buildScheme(Scheme& scheme) const;
+};
+
+// Автосборка: лучевой поиск по схемам из набора деталей внутри footprint.
+// Ходы берутся из Layer::findPlacements, поэтому каждое состояние - корректная
+// схема. Состояния одного шага раскрываются параллельно; общий лучший результат
+// отсекает ветви, чья оценка сверху его не превосходит.
+class AssemblySolver {
+private:
+    struct Node; // цепочка размещений от корня
+    struct State;
+    struct Child;
+    struct Incumbent; // лучшее найденное решение, общее для всех потоков
+
+    std::vector<SolverPiece> pieces;
+    std::vector<int> pieceConnectors; // соединителей у одной детали каждого вида
+    Rect footprint;
+    SolverOptions options;
+
+    int totalPieces;
+    int totalConnectors;
+
+    std::int64_t valueOf(int placed, int connectors, int layerCount) const;
+    std::int64_t boundOf(const State& state) const;
+    void expand(const State& state, std::size_t stateIndex, std::vector<Child>& out,
+                Incumbent& best, std::chrono::steady_clock::time_point deadline) const;
+
+public:
+    AssemblySolver(const std::vector<SolverPiece>& bag, const Rect& area,
+                   const SolverOptions& solverOptions = SolverOptions());
+
+    SolverResult solve(ThreadPool& pool) const;
+};
+
+#endif // SOLVER_H
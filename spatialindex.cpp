@@ -0,0 +1,171 @@
+// spatialindex.cpp
+#include "spatialindex.h"
+#include "metrics.h"
+#include <algorithm>
+
+const int SpatialIndex::DEFAULT_BLOCK_SIZE;
+const int SpatialIndex::MAX_ENTRY_BLOCKS;
+
+SpatialIndex::SpatialIndex(SpatialIndexType indexType, int block)
+    : type(indexType), blockSize(block > 0 ? block : DEFAULT_BLOCK_SIZE), entryCount(0) {}
+
+SpatialIndex::SpatialIndex(const SpatialIndex& other)
+    : type(other.type), blockSize(other.blockSize), entryCount(other.entryCount),
+      entries(other.entries), buckets(other.buckets) {}
+
+std::uint64_t SpatialIndex::blockKey(int blockX, int blockY) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(blockX)) << 32) |
+           static_cast<std::uint32_t>(blockY);
+}
+
+int SpatialIndex::toBlock(int coord) const {
+    return (coord >= 0) ? coord / blockSize : -((-coord + blockSize - 1) / blockSize);
+}
+
+bool SpatialIndex::inList(const IndexEntry& entry) const {
+    if (type == SpatialIndexType::LINEAR) {
+        return true;
+    }
+    long long blocksX = static_cast<long long>(toBlock(entry.x + std::max(entry.width, 1) - 1)) - toBlock(entry.x) + 1;
+    long long blocksY = static_cast<long long>(toBlock(entry.y + std::max(entry.height, 1) - 1)) - toBlock(entry.y) + 1;
+    return blocksX * blocksY > MAX_ENTRY_BLOCKS;
+}
+
+bool SpatialIndex::intersects(const IndexEntry& entry, int x, int y, int width, int height) {
+    return x < entry.x + entry.width && x + width > entry.x &&
+           y < entry.y + entry.height && y + height > entry.y;
+}
+
+void SpatialIndex::insert(const IndexEntry& entry) {
+    entryCount++;
+    if (inList(entry)) {
+        entries.push_back(entry);
+        return;
+    }
+    // Элемент попадает в каждый блок, который задевает его прямоугольник
+    int lastBlockX = toBlock(entry.x + std::max(entry.width, 1) - 1);
+    int lastBlockY = toBlock(entry.y + std::max(entry.height, 1) - 1);
+    for (int by = toBlock(entry.y); by <= lastBlockY; by++) {
+        for (int bx = toBlock(entry.x); bx <= lastBlockX; bx++) {
+            buckets[blockKey(bx, by)].push_back(entry);
+        }
+    }
+}
+
+void SpatialIndex::remove(const IndexEntry& entry) {
+    auto sameId = [&entry](const IndexEntry& other) { return other.id == entry.id; };
+    if (inList(entry)) {
+        auto it = std::find_if(entries.begin(), entries.end(), sameId);
+        if (it != entries.end()) {
+            entries.erase(it);
+            entryCount--;
+        }
+        return;
+    }
+    bool found = false;
+    int lastBlockX = toBlock(entry.x + std::max(entry.width, 1) - 1);
+    int lastBlockY = toBlock(entry.y + std::max(entry.height, 1) - 1);
+    for (int by = toBlock(entry.y); by <= lastBlockY; by++) {
+        for (int bx = toBlock(entry.x); bx <= lastBlockX; bx++) {
+            auto bucket = buckets.find(blockKey(bx, by));
+            if (bucket == buckets.end()) continue;
+            std::vector<IndexEntry>& list = bucket->second;
+            auto it = std::find_if(list.begin(), list.end(), sameId);
+            if (it != list.end()) {
+                *it = list.back();
+                list.pop_back();
+                found = true;
+            }
+            if (list.empty()) {
+                buckets.erase(bucket);
+            }
+        }
+    }
+    if (found) {
+        entryCount--;
+    }
+}
+
+void SpatialIndex::clear() {
+    entries.clear();
+    buckets.clear();
+    entryCount = 0;
+}
+
+bool SpatialIndex::intersectsAny(int x, int y, int width, int height) const {
+    for (const IndexEntry& entry : entries) {
+        METRIC_ADD(OVERLAP_SCANNED, 1);
+        if (intersects(entry, x, y, width, height)) return true;
+    }
+    if (type == SpatialIndexType::LINEAR) {
+        return false;
+    }
+    int lastBlockX = toBlock(x + std::max(width, 1) - 1);
+    int lastBlockY = toBlock(y + std::max(height, 1) - 1);
+    for (int by = toBlock(y); by <= lastBlockY; by++) {
+        for (int bx = toBlock(x); bx <= lastBlockX; bx++) {
+            auto bucket = buckets.find(blockKey(bx, by));
+            if (bucket == buckets.end()) continue;
+            for (const IndexEntry& entry : bucket->second) {
+                METRIC_ADD(OVERLAP_SCANNED, 1);
+                if (intersects(entry, x, y, width, height)) return true;
+            }
+        }
+    }
+    return false;
+}
+
+const IndexEntry* SpatialIndex::findAt(int x, int y) const {
+    for (const IndexEntry& entry : entries) {
+        if (intersects(entry, x, y, 1, 1)) return &entry;
+    }
+    if (type == SpatialIndexType::LINEAR) {
+        return nullptr;
+    }
+    auto bucket = buckets.find(blockKey(toBlock(x), toBlock(y)));
+    if (bucket == buckets.end()) return nullptr;
+    for (const IndexEntry& entry : bucket->second) {
+        if (intersects(entry, x, y, 1, 1)) return &entry;
+    }
+    return nullptr;
+}
+
+void SpatialIndex::query(int x, int y, int width, int height, std::vector<IndexEntry>& out) const {
+    out.clear();
+    for (const IndexEntry& entry : entries) {
+        if (intersects(entry, x, y, width, height)) out.push_back(entry);
+    }
+    if (type == SpatialIndexType::LINEAR) {
+        return;
+    }
+    int lastBlockX = toBlock(x + std::max(width, 1) - 1);
+    int lastBlockY = toBlock(y + std::max(height, 1) - 1);
+    for (int by = toBlock(y); by <= lastBlockY; by++) {
+        for (int bx = toBlock(x); bx <= lastBlockX; bx++) {
+            auto bucket = buckets.find(blockKey(bx, by));
+            if (bucket == buckets.end()) continue;
+            for (const IndexEntry& entry : bucket->second) {
+                if (intersects(entry, x, y, width, height)) out.push_back(entry);
+            }
+        }
+    }
+    // Элементы сетки могут лежать в нескольких блоках - убираем повторы
+    std::sort(out.begin(), out.end(),
+              [](const IndexEntry& a, const IndexEntry& b) { return a.id < b.id; });
+    out.erase(std::unique(out.begin(), out.end(),
+                          [](const IndexEntry& a, const IndexEntry& b) { return a.id == b.id; }),
+              out.end());
+}
+
+SpatialIndexType SpatialIndex::getType() const { return type; }
+int SpatialIndex::getBlockSize() const { return blockSize; }
+size_t SpatialIndex::size() const { return entryCount; }
+
+size_t SpatialIndex::getMemoryUsage() const {
+    size_t bytes = entries.capacity() * sizeof(IndexEntry) + buckets.bucket_count() * sizeof(void*);
+    for (const auto& bucket : buckets) {
+        // Узел таблицы: пара ключ-список и указатель на следующий узел
+        bytes += sizeof(bucket) + sizeof(void*) + bucket.second.capacity() * sizeof(IndexEntry);
+    }
+    return bytes;
+}
@@ -0,0 +1,70 @@
+// spatialindex.h
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include "element.h"
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum class SpatialIndexType
+{
+    LINEAR, // один список, запросы перебирают все элементы
+    GRID,   // равномерная сетка блоков blockSize x blockSize, крупные элементы - списком
+};
+
+// Элемент, размещенный в индексе: id размещения и его прямоугольник.
+// Размер и форма запоминаются при вставке - элемент потом могут изменить
+struct IndexEntry {
+    Element* elem;
+    int id;
+    int x;
+    int y;
+    int width;
+    int height;
+    const Shape* shape; // форма на момент вставки (nullptr, если не нужна)
+};
+
+class SpatialIndex {
+private:
+    SpatialIndexType type;
+    int blockSize;
+    size_t entryCount;
+    std::vector<IndexEntry> entries; // LINEAR - все элементы, GRID - крупные
+    std::unordered_map<std::uint64_t, std::vector<IndexEntry>> buckets; // GRID
+
+    static std::uint64_t blockKey(int blockX, int blockY);
+    int toBlock(int coord) const;
+    // Хранится ли элемент в списке entries, а не в блоках сетки
+    bool inList(const IndexEntry& entry) const;
+    static bool intersects(const IndexEntry& entry, int x, int y, int width, int height);
+
+public:
+    static const int DEFAULT_BLOCK_SIZE = 16;
+    // Элемент, задевающий больше блоков, в сетку не раскладывается: иначе
+    // он занимал бы (w / blockSize) * (h / blockSize) записей
+    static const int MAX_ENTRY_BLOCKS = 16;
+
+    SpatialIndex(SpatialIndexType indexType = SpatialIndexType::GRID,
+                 int block = DEFAULT_BLOCK_SIZE);
+    SpatialIndex(const SpatialIndex& other); // Конструктор копирования
+
+    void insert(const IndexEntry& entry);
+    void remove(const IndexEntry& entry);
+    void clear();
+
+    // Есть ли элемент, пересекающий прямоугольник
+    bool intersectsAny(int x, int y, int width, int height) const;
+    // Элемент, прямоугольник которого содержит клетку (x, y), или nullptr
+    const IndexEntry* findAt(int x, int y) const;
+    // Все элементы, пересекающие прямоугольник (каждый один раз)
+    void query(int x, int y, int width, int height, std::vector<IndexEntry>& out) const;
+
+    SpatialIndexType getType() const;
+    int getBlockSize() const;
+    size_t size() const;
+    size_t getMemoryUsage() const; // оценка: списки, корзины и узлы таблицы
+};
+
+#endif // SPATIALINDEX_H
@@ -0,0 +1,120 @@
+// threadpool.cpp
+#include "threadpool.h"
+
+// Номер очереди текущего потока внутри своего пула
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentQueue = 0;
+
+ThreadPool::ThreadPool(unsigned threadCount)
+    : pending(0), queued(0), nextQueue(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Задачи, порожденные внутри пула, кладем в свою очередь потока
+    size_t queueIndex = (currentPool == this)
+        ? currentQueue
+        : nextQueue.fetch_add(1) % queues.size();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[queueIndex]->mutex);
+        queues[queueIndex]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued++;
+    }
+    wakeup.notify_one();
+}
+
+bool ThreadPool::popTask(size_t queueIndex, std::function<void()>& task) {
+    // Своя очередь - с конца
+    {
+        WorkQueue& own = *queues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // Чужие очереди - с начала
+    for (size_t offset = 1; offset < queues.size(); offset++) {
+        WorkQueue& victim = *queues[(queueIndex + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::runOneTask(size_t preferredQueue) {
+    std::function<void()> task;
+    if (!popTask(preferredQueue, task)) {
+        return false;
+    }
+    queued--;
+    task();
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        finished.notify_all();
+    }
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t queueIndex) {
+    currentPool = this;
+    currentQueue = queueIndex;
+    while (true) {
+        if (runOneTask(queueIndex)) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wakeup.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::wait() {
+    size_t preferred = (currentPool == this) ? currentQueue : 0;
+    while (pending > 0) {
+        if (runOneTask(preferred)) {
+            continue;
+        }
+        // Очереди пусты, но задачи еще выполняются в других потоках
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        finished.wait(lock, [this] { return pending == 0 || queued > 0; });
+    }
+}
+
+unsigned ThreadPool::getThreadCount() const {
+    return static_cast<unsigned>(threads.size());
+}
@@ -0,0 +1,51 @@
+// threadpool.h
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с собственной очередью у каждого потока.
+// Поток берет задачи с конца своей очереди, а когда она пуста -
+// забирает (крадет) задачи из начала очередей других потоков.
+class ThreadPool {
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    std::atomic<size_t> pending;  // поставлено, но еще не выполнено
+    std::atomic<size_t> queued;   // лежит в очередях
+    std::atomic<size_t> nextQueue;
+    bool stopping;
+
+    bool popTask(size_t queueIndex, std::function<void()>& task);
+    bool runOneTask(size_t preferredQueue);
+    void workerLoop(size_t queueIndex);
+
+public:
+    // 0 - по числу аппаратных потоков
+    explicit ThreadPool(unsigned threadCount = 0);
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    // Ждет выполнения всех задач; вызывающий поток тоже выполняет задачи
+    void wait();
+    unsigned getThreadCount() const;
+};
+
+#endif // THREADPOOL_H